@@ -0,0 +1,294 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <ucontext.h>
+#include "main.h"
+
+// M:N execution: every plane is a coroutine with a small stack, a few worker threads run them.
+// One mutex guards the run queue, the sleeping planes and the deck, it is held while switching contexts
+// (a worker locks it before resuming a plane, the plane unlocks it after it gets back the control).
+#define FIBER_STACK_SIZE (8 * 1024)
+
+struct fiber {
+    ucontext_t context;
+    int plane_id;
+    int worker;
+    int on_deck;
+    int landing;
+    uint64_t wake_time;
+    // the stream of the plane, it is the stream of the worker while the plane runs.
+    uint64_t rng_state[4];
+    struct fiber *next;
+};
+
+struct fiber_worker {
+    ucontext_t scheduler;
+    pthread_t thread;
+    struct plane_stats *stats;
+};
+
+struct fiber_queue {
+    struct fiber *head;
+    struct fiber *tail;
+};
+
+pthread_mutex_t fibers_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t fibers_cond;
+struct fiber *fibers;
+char *fibers_stacks;
+struct fiber_worker *workers;
+int workers_num, workers_started = 0;
+int fibers_stop_flag = 0;
+struct fiber_queue run_queue, fiber_land_queue, fiber_start_queue;
+// min-heap of sleeping planes ordered by wake_time.
+struct fiber **sleeping;
+int sleeping_num = 0;
+int fibers_on_deck = 0, fibers_runway_free = 1;
+
+void fiber_queue_push(struct fiber_queue *queue, struct fiber *fiber) {
+    fiber->next = NULL;
+    if (queue->tail != NULL)
+        queue->tail->next = fiber;
+    else
+        queue->head = fiber;
+    queue->tail = fiber;
+}
+
+struct fiber *fiber_queue_pop(struct fiber_queue *queue) {
+    struct fiber *fiber = queue->head;
+    if (fiber != NULL) {
+        queue->head = fiber->next;
+        if (queue->head == NULL)
+            queue->tail = NULL;
+    }
+    return fiber;
+}
+
+void sleeping_push(struct fiber *fiber) {
+    int i = sleeping_num++;
+    while (i > 0 && fiber->wake_time < sleeping[(i - 1) / 2]->wake_time) {
+        sleeping[i] = sleeping[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sleeping[i] = fiber;
+}
+
+struct fiber *sleeping_pop() {
+    struct fiber *first = sleeping[0];
+    struct fiber *last = sleeping[--sleeping_num];
+    int i = 0;
+    while (2 * i + 1 < sleeping_num) {
+        int child = 2 * i + 1;
+        if (child + 1 < sleeping_num && sleeping[child + 1]->wake_time < sleeping[child]->wake_time)
+            child++;
+        if (sleeping[child]->wake_time >= last->wake_time)
+            break;
+        sleeping[i] = sleeping[child];
+        i = child;
+    }
+    sleeping[i] = last;
+    return first;
+}
+
+void make_runnable(struct fiber *fiber) {
+    fiber_queue_push(&run_queue, fiber);
+    pthread_cond_signal(&fibers_cond);
+}
+
+// must be called with fibers_mutex locked, returns with it locked when the plane is resumed.
+void fiber_park(struct fiber *fiber) {
+    swapcontext(&fiber->context, &workers[fiber->worker].scheduler);
+}
+
+// sleeping for 0 just lets other planes run, there is no preemption.
+void fiber_sleep(struct fiber *fiber, unsigned int utime) {
+    pthread_mutex_lock(&fibers_mutex);
+    if (utime == 0) {
+        fiber_queue_push(&run_queue, fiber);
+    }
+    else {
+        fiber->wake_time = bench_now_ns() + (uint64_t)utime * 1000;
+        sleeping_push(fiber);
+    }
+    fiber_park(fiber);
+    pthread_mutex_unlock(&fibers_mutex);
+}
+
+// the same rules as in the handoff mode: the plane freeing the runway passes it to the chosen waiting plane.
+void fibers_grant_runway() {
+    struct fiber_queue *queue = NULL;
+    if (fibers_on_deck < k)
+        queue = fiber_land_queue.head != NULL ? &fiber_land_queue :
+                fiber_start_queue.head != NULL ? &fiber_start_queue : NULL;
+    else if (fiber_start_queue.head != NULL)
+        queue = &fiber_start_queue;
+    else if (fiber_land_queue.head != NULL && fibers_on_deck < n)
+        queue = &fiber_land_queue;
+    if (queue == NULL) {
+        fibers_runway_free = 1;
+        return;
+    }
+    struct fiber *fiber = fiber_queue_pop(queue);
+    fibers_on_deck += fiber->landing ? 1 : -1;
+    fiber->on_deck = fibers_on_deck;
+    make_runnable(fiber);
+}
+
+void fiber_take_runway(struct fiber *fiber, int landing) {
+    struct fiber_queue *queue = landing ? &fiber_land_queue : &fiber_start_queue;
+    uint64_t wait_start = bench_now_ns();
+    pthread_mutex_lock(&fibers_mutex);
+    int on_deck = fibers_on_deck;
+    if (verbose)
+        evlog(landing ? EVENT_GOING_TO_LAND : EVENT_GOING_TO_START, on_deck, fiber->plane_id, 0, 0, 0);
+    int can_go = fibers_runway_free && queue->head == NULL && (landing ?
+            fibers_on_deck < n && !(fibers_on_deck >= k && fiber_start_queue.head != NULL) :
+            !(fibers_on_deck < k && fiber_land_queue.head != NULL));
+    if (can_go) {
+        fibers_runway_free = 0;
+        fibers_on_deck += landing ? 1 : -1;
+        fiber->on_deck = fibers_on_deck;
+    }
+    else {
+        fiber->landing = landing;
+        fiber_queue_push(queue, fiber);
+        fiber_park(fiber);
+    }
+    pthread_mutex_unlock(&fibers_mutex);
+
+    // the plane may be resumed by another worker, so its stats are looked up only now.
+    struct plane_stats *stats = workers[fiber->worker].stats;
+    if (!can_go)
+        stats->wakeups++;
+    if (landing) {
+        stats->landings++;
+        metrics_count(fiber->plane_id, 0);
+        histogram_record(&stats->land_wait, bench_now_ns() - wait_start);
+    }
+    else {
+        stats->starts++;
+        metrics_count(fiber->plane_id, 1);
+        histogram_record(&stats->start_wait, bench_now_ns() - wait_start);
+    }
+    if (stress != NULL)
+        stress_runway_taken(fiber->plane_id, 0, fiber->on_deck, landing);
+    if (verbose)
+        evlog(landing ? EVENT_LANDING : EVENT_STARTING, fiber->on_deck, fiber->plane_id, 0, 0, 0);
+}
+
+void fiber_free_runway() {
+    if (stress != NULL)
+        stress_runway_freed(0);
+    pthread_mutex_lock(&fibers_mutex);
+    fibers_grant_runway();
+    pthread_mutex_unlock(&fibers_mutex);
+}
+
+void fiber_plane(int plane_id) {
+    struct fiber *fiber = &fibers[plane_id];
+    // the first switch into the plane comes from a worker holding fibers_mutex.
+    pthread_mutex_unlock(&fibers_mutex);
+    unsigned int min_time = start_land_utime > 0 ? 500000 : 0, max_time = start_land_utime > 0 ? 1000000 : 1;
+    while (1) {
+        fiber_sleep(fiber, random_utime(min_time, max_time));
+        fiber_take_runway(fiber, 1);
+        fiber_sleep(fiber, start_land_utime);
+        fiber_free_runway();
+        fiber_sleep(fiber, random_utime(min_time, max_time));
+        fiber_take_runway(fiber, 0);
+        fiber_sleep(fiber, start_land_utime);
+        fiber_free_runway();
+    }
+}
+
+void *fiber_worker_thread(void *arg) {
+    int worker = (int)(intptr_t)arg;
+    // planes move between workers, so the stream of a plane is switched in while it runs.
+    rng_seed_thread(worker);
+    pin_thread("Worker", worker, worker);
+    pthread_mutex_lock(&fibers_mutex);
+    while (!fibers_stop_flag) {
+        uint64_t now = bench_now_ns();
+        while (sleeping_num > 0 && sleeping[0]->wake_time <= now)
+            fiber_queue_push(&run_queue, sleeping_pop());
+        struct fiber *fiber = fiber_queue_pop(&run_queue);
+        if (fiber != NULL) {
+            fiber->worker = worker;
+            memcpy(rng_state, fiber->rng_state, sizeof rng_state);
+            swapcontext(&workers[worker].scheduler, &fiber->context);
+            memcpy(fiber->rng_state, rng_state, sizeof rng_state);
+            continue;
+        }
+        if (sleeping_num > 0) {
+            struct timespec deadline = {(time_t)(sleeping[0]->wake_time / 1000000000ull),
+                                        (long)(sleeping[0]->wake_time % 1000000000ull)};
+            pthread_cond_timedwait(&fibers_cond, &fibers_mutex, &deadline);
+        }
+        else {
+            pthread_cond_wait(&fibers_cond, &fibers_mutex);
+        }
+    }
+    pthread_mutex_unlock(&fibers_mutex);
+    return NULL;
+}
+
+int fibers_start(int workers_number, struct plane_stats *stats) {
+    workers_num = workers_number;
+    pthread_condattr_t cond_attr;
+    pthread_condattr_init(&cond_attr);
+    pthread_condattr_setclock(&cond_attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&fibers_cond, &cond_attr);
+    pthread_condattr_destroy(&cond_attr);
+    fibers = calloc(planes_num, sizeof(struct fiber));
+    fibers_stacks = malloc((size_t)planes_num * FIBER_STACK_SIZE);
+    sleeping = malloc(planes_num * sizeof(struct fiber *));
+    workers = calloc(workers_num, sizeof(struct fiber_worker));
+    if (fibers == NULL || fibers_stacks == NULL || sleeping == NULL || workers == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+
+    for (int i = 0; i < planes_num; i++) {
+        struct fiber *fiber = &fibers[i];
+        fiber->plane_id = i;
+        rng_seed_state(i, fiber->rng_state);
+        getcontext(&fiber->context);
+        fiber->context.uc_stack.ss_sp = fibers_stacks + (size_t)i * FIBER_STACK_SIZE;
+        fiber->context.uc_stack.ss_size = FIBER_STACK_SIZE;
+        fiber->context.uc_link = NULL;
+        makecontext(&fiber->context, (void (*)())fiber_plane, 1, i);
+        fiber_queue_push(&run_queue, fiber);
+    }
+    for (int i = 0; i < workers_num; i++) {
+        workers[i].stats = &stats[i];
+        if (pthread_create(&workers[i].thread, NULL, fiber_worker_thread, (void *)(intptr_t)i) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            return 1;
+        }
+        workers_started++;
+    }
+    return 0;
+}
+
+// planes are left suspended wherever they are, only the workers are joined.
+void fibers_stop() {
+    if (workers == NULL)
+        return;
+    pthread_mutex_lock(&fibers_mutex);
+    fibers_stop_flag = 1;
+    pthread_cond_broadcast(&fibers_cond);
+    pthread_mutex_unlock(&fibers_mutex);
+    for (int i = 0; i < workers_started; i++)
+        pthread_join(workers[i].thread, NULL);
+    workers_started = 0;
+    pthread_cond_destroy(&fibers_cond);
+    free(fibers);
+    free(fibers_stacks);
+    free(sleeping);
+    free(workers);
+    fibers = NULL;
+    fibers_stacks = NULL;
+    sleeping = NULL;
+    workers = NULL;
+}
@@ -0,0 +1,169 @@
+#include <stdio.h>
+#include "../common/futex.h"
+#include "main.h"
+
+int handoff_init();
+int handoff_land(int plane_id, int *on_deck);
+int handoff_start(int plane_id, int *on_deck);
+void handoff_free_runway(int runway);
+void handoff_destroy();
+
+struct carrier_mode handoff_mode = {
+        "handoff", handoff_init, handoff_land, handoff_start, handoff_free_runway, handoff_destroy
+};
+
+// every waiting plane sleeps on its own word, the plane freeing a runway hands it over directly.
+struct handoff_waiter {
+    atomic_int granted;
+    int runway;
+    int on_deck;
+    int landing;
+    struct handoff_waiter *prev;
+    struct handoff_waiter *next;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct handoff_queue {
+    struct handoff_waiter *head;
+    struct handoff_waiter *tail;
+};
+
+pthread_mutex_t handoff_mutex = PTHREAD_MUTEX_INITIALIZER;
+struct handoff_queue land_queue, start_queue;
+int handoff_on_deck;
+int free_runways[MAX_RUNWAYS];
+int free_runways_num;
+
+int handoff_init() {
+    land_queue.head = land_queue.tail = NULL;
+    start_queue.head = start_queue.tail = NULL;
+    handoff_on_deck = 0;
+    for (free_runways_num = 0; free_runways_num < runways_num; free_runways_num++)
+        free_runways[free_runways_num] = runways_num - free_runways_num - 1;
+    return 0;
+}
+
+void queue_push(struct handoff_queue *queue, struct handoff_waiter *waiter) {
+    waiter->next = NULL;
+    waiter->prev = queue->tail;
+    if (queue->tail != NULL)
+        queue->tail->next = waiter;
+    else
+        queue->head = waiter;
+    queue->tail = waiter;
+}
+
+void queue_remove(struct handoff_queue *queue, struct handoff_waiter *waiter) {
+    if (waiter->prev != NULL)
+        waiter->prev->next = waiter->next;
+    else
+        queue->head = waiter->next;
+    if (waiter->next != NULL)
+        waiter->next->prev = waiter->prev;
+    else
+        queue->tail = waiter->prev;
+}
+
+// the same priorities as free_airstrip(), but only a plane which really can go is chosen.
+struct handoff_queue *choose_queue() {
+    if (handoff_on_deck < k) {
+        if (land_queue.head != NULL)
+            return &land_queue;
+        if (start_queue.head != NULL)
+            return &start_queue;
+    }
+    else {
+        if (start_queue.head != NULL)
+            return &start_queue;
+        if (land_queue.head != NULL && handoff_on_deck < n)
+            return &land_queue;
+    }
+    return NULL;
+}
+
+// must be called with handoff_mutex locked.
+void grant_waiters() {
+    struct handoff_queue *queue;
+    while (free_runways_num > 0 && (queue = choose_queue()) != NULL) {
+        struct handoff_waiter *waiter = queue->head;
+        queue_remove(queue, waiter);
+        handoff_on_deck += waiter->landing ? 1 : -1;
+        waiter->runway = free_runways[--free_runways_num];
+        waiter->on_deck = handoff_on_deck;
+        atomic_store(&waiter->granted, 1);
+        futex_wake(&waiter->granted, 1);
+    }
+}
+
+// cancelled waiter leaves the queue, or passes on the runway it has just been given.
+void handoff_wait_cleanup(void *arg) {
+    struct handoff_waiter *waiter = arg;
+    pthread_mutex_lock(&handoff_mutex);
+    if (atomic_load(&waiter->granted) == 0) {
+        queue_remove(waiter->landing ? &land_queue : &start_queue, waiter);
+    }
+    else {
+        handoff_on_deck += waiter->landing ? -1 : 1;
+        free_runways[free_runways_num++] = waiter->runway;
+    }
+    grant_waiters();
+    pthread_mutex_unlock(&handoff_mutex);
+}
+
+// nothing which is a cancellation point is called with handoff_mutex locked, so printing is done after unlocking.
+int handoff_take_runway(int plane_id, int landing, int *granted_on_deck) {
+    struct handoff_waiter waiter;
+    struct handoff_queue *queue = landing ? &land_queue : &start_queue;
+    pthread_mutex_lock(&handoff_mutex);
+    int on_deck = handoff_on_deck;
+    int can_go = free_runways_num > 0 && queue->head == NULL && (landing ?
+            handoff_on_deck < n && !(handoff_on_deck >= k && start_queue.head != NULL) :
+            !(handoff_on_deck < k && land_queue.head != NULL));
+    if (can_go) {
+        handoff_on_deck += landing ? 1 : -1;
+        waiter.runway = free_runways[--free_runways_num];
+        waiter.on_deck = handoff_on_deck;
+        // e.g. a start may allow planes waiting for a full deck to land on the other runways.
+        grant_waiters();
+    }
+    else {
+        waiter.landing = landing;
+        atomic_init(&waiter.granted, 0);
+        queue_push(queue, &waiter);
+    }
+    pthread_mutex_unlock(&handoff_mutex);
+    if (verbose)
+        evlog(landing ? EVENT_GOING_TO_LAND : EVENT_GOING_TO_START, on_deck, plane_id, 0, 0, 0);
+
+    if (!can_go) {
+        pthread_cleanup_push(handoff_wait_cleanup, &waiter);
+        while (atomic_load(&waiter.granted) == 0) {
+            futex_wait(&waiter.granted, 0);
+            planes_stats[plane_id].wakeups++;
+        }
+        pthread_cleanup_pop(0);
+    }
+    if (verbose)
+        evlog(landing ? EVENT_LANDING_ON_RUNWAY : EVENT_STARTING_ON_RUNWAY, waiter.on_deck, plane_id, waiter.runway,
+              0, 0);
+    *granted_on_deck = waiter.on_deck;
+    return waiter.runway;
+}
+
+int handoff_land(int plane_id, int *on_deck) {
+    return handoff_take_runway(plane_id, 1, on_deck);
+}
+
+int handoff_start(int plane_id, int *on_deck) {
+    return handoff_take_runway(plane_id, 0, on_deck);
+}
+
+void handoff_free_runway(int runway) {
+    pthread_mutex_lock(&handoff_mutex);
+    free_runways[free_runways_num++] = runway;
+    grant_waiters();
+    pthread_mutex_unlock(&handoff_mutex);
+}
+
+void handoff_destroy() {
+    pthread_mutex_destroy(&handoff_mutex);
+}
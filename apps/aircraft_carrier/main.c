@@ -4,56 +4,120 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <unistd.h>
-
-#define START_LAND_TIME 100000
+#include <string.h>
+#include <stdatomic.h>
+#include "main.h"
 
 int read_args(int argc, char *argv[], int *n, int *k, int *planes_num);
 void cleanup();
-unsigned int random_utime(unsigned int min, unsigned int max);
 void sigint_handler(int signum);
 void *plane_thread(void *arg);
+void *bench_plane_thread(void *arg);
 void thread_cleanup(void *args);
+int get_plane_id();
 void start(int plane_id);
 void land(int plane_id);
+int mutex_land(int plane_id, int *on_deck);
+int mutex_start(int plane_id, int *on_deck);
+void mutex_free_runway(int runway);
 void free_airstrip();
+int run_bench(sigset_t *old_signal_mask);
+int run_stats(sigset_t *old_signal_mask);
+int run_sim();
+int run_fibers();
+void print_bench_report(char *kind, char *mode_name, struct plane_stats *stats, int stats_num, double elapsed);
+
+struct carrier_mode mutex_mode = {
+        "mutex", NULL, mutex_land, mutex_start, mutex_free_runway, NULL
+};
+struct carrier_mode *mode = &mutex_mode;
+
+const char *events_formats[] = {
+        "%3d | Plane #%-3d is going to land.\n",
+        "%3d | Plane #%-3d is going to start.\n",
+        "%3d | Plane #%-3d is landing.\n",
+        "%3d | Plane #%-3d is starting.\n",
+        "%3d | Plane #%-3d is landing on runway %d.\n",
+        "%3d | Plane #%-3d is starting on runway %d.\n"
+};
 
 int n, k, planes_num, on_aircraft_carrier = 0, available = 1;
+int runways_num = 1;
 pthread_mutex_t aircraft_carrier_mutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_key_t aircraft_carrier_locked;
 pthread_cond_t start_cond = PTHREAD_COND_INITIALIZER;
 pthread_cond_t land_cond = PTHREAD_COND_INITIALIZER;
 int start_counter = 0, land_counter = 0;
 pthread_t *threads_ids;
+int threads_started = 0;
+int verbose = 1;
+unsigned int start_land_utime = START_LAND_TIME;
+
+enum run_kind run_kind = DEMO;
+double run_seconds = 0;
+int fibers_workers_num = 0;
+struct plane_stats *fibers_stats;
+atomic_int bench_running;
+pthread_barrier_t bench_barrier;
+struct plane_stats *planes_stats;
 
 int main(int argc, char *argv[]) {
     atexit(cleanup);
     struct sigaction act;
+    memset(&act, 0, sizeof act);
     act.sa_handler = sigint_handler;
     sigaction(SIGINT, &act, NULL);
     sigaction(SIGTSTP, &act, NULL);
 
-    char *args_help = "Enter N, K and a number of planes.\n";
+    char *args_help = "Enter N, K and a number of planes, optionally mode (mutex, or runways or handoff with\n"
+            "a number of runways, or fibers with a number of worker threads) and bench, stress, stats or sim\n"
+            "with a number of seconds, and log with a file for binary event log.\n"
+            "Every mode accepts seed with a number and pin with compact, scatter, smt-avoid or a CPU list.\n";
+    if (rng_init(&argc, argv) != 0 || pin_init(&argc, argv) != 0 ||
+        evlog_init(&argc, argv, events_formats, EVENTS_NUM) != 0)
+        return 1;
     if (read_args(argc, argv, &n, &k, &planes_num) != 0) {
         printf(args_help);
         return 1;
     }
+    if (run_kind == SIM)
+        return run_sim();
+    if (run_kind == STRESS && stress_create(runways_num) != 0)
+        return 1;
+    char *counters_names[] = {"landings", "starts"};
+    metrics_create("aircraft", "plane", planes_num, counters_names, 2, NULL, 0);
+    if (fibers_workers_num > 0)
+        return run_fibers();
 
     threads_ids = malloc(planes_num * sizeof(pthread_t));
-    if (threads_ids == NULL) {
+    planes_stats = aligned_alloc(CACHE_LINE_SIZE, planes_num * sizeof(struct plane_stats));
+    if (threads_ids == NULL || planes_stats == NULL) {
         printf("Error while allocating memory occurred.\n");
         return 1;
     }
+    for (int i = 0; i < planes_num; i++) {
+        planes_stats[i].landings = planes_stats[i].starts = planes_stats[i].wakeups = 0;
+        histogram_init(&planes_stats[i].land_wait);
+        histogram_init(&planes_stats[i].start_wait);
+    }
+    if (mode->init != NULL && mode->init() != 0)
+        return 1;
     pthread_key_create(&aircraft_carrier_locked, NULL);
     // prepare mask for planes' threads (after that, only main thread will catch signals).
     sigset_t signal_mask;
     sigset_t old_signal_mask;
     sigfillset(&signal_mask);
     pthread_sigmask(SIG_SETMASK, &signal_mask, &old_signal_mask);
+    if (run_kind == BENCH || run_kind == STRESS)
+        return run_bench(&old_signal_mask);
+    if (run_kind == STATS)
+        return run_stats(&old_signal_mask);
     for (int i = 0; i < planes_num; i++) {
         if (pthread_create(&(threads_ids[i]), NULL, plane_thread, NULL) != 0) {
             printf("Error while creating new thread occurred.\n");
             break;
         }
+        threads_started++;
     }
     pthread_sigmask(SIG_SETMASK, &old_signal_mask, NULL);
 
@@ -62,18 +126,22 @@ int main(int argc, char *argv[]) {
 }
 
 unsigned int random_utime(unsigned int min, unsigned int max) {
-    return ((unsigned)rand() % (max - min)) + min;
+    return rng_range(min, max);
 }
 
-void *plane_thread(void *arg) {
-    pthread_cleanup_push(thread_cleanup, NULL);
-    int plane_id = 0;
+int get_plane_id() {
     for (int i = 0; i < planes_num; i++) {
-        if (pthread_equal(threads_ids[i], pthread_self())) {
-            plane_id = i;
-            break;
-        }
+        if (pthread_equal(threads_ids[i], pthread_self()))
+            return i;
     }
+    return 0;
+}
+
+void *plane_thread(void *arg) {
+    pthread_cleanup_push(thread_cleanup, NULL);
+    int plane_id = get_plane_id();
+    rng_seed_thread(plane_id);
+    pin_thread("Plane", plane_id, plane_id);
     int * airstrip_locked = malloc(sizeof(int));
     *airstrip_locked = 0;
     pthread_setspecific(aircraft_carrier_locked, airstrip_locked);
@@ -88,6 +156,59 @@ void *plane_thread(void *arg) {
     return NULL;
 }
 
+void land(int plane_id) {
+    uint64_t wait_start = bench_now_ns();
+    int on_deck;
+    int runway = mode->land(plane_id, &on_deck);
+    histogram_record(&planes_stats[plane_id].land_wait, bench_now_ns() - wait_start);
+    planes_stats[plane_id].landings++;
+    metrics_count(plane_id, 0);
+    if (stress != NULL)
+        stress_runway_taken(plane_id, runway, on_deck, 1);
+    if (start_land_utime > 0)
+        usleep(start_land_utime);
+    if (stress != NULL)
+        stress_runway_freed(runway);
+    mode->free_runway(runway);
+}
+
+void start(int plane_id) {
+    uint64_t wait_start = bench_now_ns();
+    int on_deck;
+    int runway = mode->start(plane_id, &on_deck);
+    histogram_record(&planes_stats[plane_id].start_wait, bench_now_ns() - wait_start);
+    planes_stats[plane_id].starts++;
+    metrics_count(plane_id, 1);
+    if (stress != NULL)
+        stress_runway_taken(plane_id, runway, on_deck, 0);
+    if (start_land_utime > 0)
+        usleep(start_land_utime);
+    if (stress != NULL)
+        stress_runway_freed(runway);
+    mode->free_runway(runway);
+}
+
+// shadow r counts the planes on runway r, a plane changes it only while it holds the runway. The deck is checked
+// on the number of planes the mode gave the runway with: read in the same lock or CAS as the grant, it is exact.
+void stress_runway_taken(int plane_id, int runway, int on_deck, int landing) {
+    if (runway < 0 || runway >= runways_num) {
+        stress_violation("Plane #%d got runway %d of %d.", plane_id, runway, runways_num);
+        return;
+    }
+    long long on_runway = stress_add(runway, 1);
+    if (on_runway != 1)
+        stress_violation("Plane #%d is %s on runway %d with %lld planes on it.", plane_id,
+                         landing ? "landing" : "starting", runway, on_runway);
+    if (on_deck > n || on_deck < 0)
+        stress_violation("Plane #%d is %s with %d planes on deck, N is %d.", plane_id,
+                         landing ? "landing" : "starting", on_deck, n);
+}
+
+void stress_runway_freed(int runway) {
+    if (runway >= 0 && runway < runways_num)
+        stress_add(runway, -1);
+}
+
 void free_airstrip() {
     if (on_aircraft_carrier < k)
         if (land_counter > 0)
@@ -101,52 +222,54 @@ void free_airstrip() {
             pthread_cond_signal(&land_cond);
 }
 
-void start(int plane_id) {
+int mutex_start(int plane_id, int *on_deck) {
     int * airstrip_locked = pthread_getspecific(aircraft_carrier_locked);
     pthread_mutex_lock(&aircraft_carrier_mutex);
     *airstrip_locked = 1;
-    printf("%3d | Plane #%-3d is going to start.\n", on_aircraft_carrier, plane_id);
+    if (verbose)
+        evlog(EVENT_GOING_TO_START, on_aircraft_carrier, plane_id, 0, 0, 0);
     start_counter++;
     while (!available || (on_aircraft_carrier < k && land_counter > 0)) {
         pthread_cond_wait(&start_cond, &aircraft_carrier_mutex);
+        planes_stats[plane_id].wakeups++;
     }
 
     on_aircraft_carrier--;
     start_counter--;
-    printf("%3d | Plane #%-3d is starting.\n", on_aircraft_carrier, plane_id);
+    *on_deck = on_aircraft_carrier;
+    if (verbose)
+        evlog(EVENT_STARTING, on_aircraft_carrier, plane_id, 0, 0, 0);
     available = 0;
     pthread_mutex_unlock(&aircraft_carrier_mutex);
     *airstrip_locked = 0;
-
-    usleep(START_LAND_TIME);
-
-    pthread_mutex_lock(&aircraft_carrier_mutex);
-    *airstrip_locked = 1;
-    available = 1;
-    free_airstrip();
-    pthread_mutex_unlock(&aircraft_carrier_mutex);
-    *airstrip_locked = 0;
+    return 0;
 }
 
-void land(int plane_id) {
+int mutex_land(int plane_id, int *on_deck) {
     int * airstrip_locked = pthread_getspecific(aircraft_carrier_locked);
     pthread_mutex_lock(&aircraft_carrier_mutex);
     *airstrip_locked = 1;
-    printf("%3d | Plane #%-3d is going to land.\n", on_aircraft_carrier, plane_id);
+    if (verbose)
+        evlog(EVENT_GOING_TO_LAND, on_aircraft_carrier, plane_id, 0, 0, 0);
     land_counter++;
     while (!available || on_aircraft_carrier == n || (on_aircraft_carrier >= k && start_counter > 0)) {
         pthread_cond_wait(&land_cond, &aircraft_carrier_mutex);
+        planes_stats[plane_id].wakeups++;
     }
 
     on_aircraft_carrier++;
     land_counter--;
-    printf("%3d | Plane #%-3d is landing.\n", on_aircraft_carrier, plane_id);
+    *on_deck = on_aircraft_carrier;
+    if (verbose)
+        evlog(EVENT_LANDING, on_aircraft_carrier, plane_id, 0, 0, 0);
     available = 0;
     pthread_mutex_unlock(&aircraft_carrier_mutex);
     *airstrip_locked = 0;
+    return 0;
+}
 
-    usleep(START_LAND_TIME);
-
+void mutex_free_runway(int runway) {
+    int * airstrip_locked = pthread_getspecific(aircraft_carrier_locked);
     pthread_mutex_lock(&aircraft_carrier_mutex);
     *airstrip_locked = 1;
     available = 1;
@@ -155,8 +278,155 @@ void land(int plane_id) {
     *airstrip_locked = 0;
 }
 
+// planes land and start in a loop without sleeps and printing.
+void *bench_plane_thread(void *arg) {
+    int airstrip_locked = 0;
+    pthread_setspecific(aircraft_carrier_locked, &airstrip_locked);
+    int plane_id = get_plane_id();
+    rng_seed_thread(plane_id);
+    pin_thread("Plane", plane_id, plane_id);
+    pthread_barrier_wait(&bench_barrier);
+    while (atomic_load_explicit(&bench_running, memory_order_relaxed)) {
+        land(plane_id);
+        start(plane_id);
+    }
+    return NULL;
+}
+
+int run_bench(sigset_t *old_signal_mask) {
+    verbose = 0;
+    start_land_utime = 0;
+    atomic_store(&bench_running, 1);
+    pthread_barrier_init(&bench_barrier, NULL, planes_num + 1);
+    for (int i = 0; i < planes_num; i++) {
+        if (pthread_create(&(threads_ids[i]), NULL, bench_plane_thread, NULL) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            exit(1);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, old_signal_mask, NULL);
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t start = bench_now_ns();
+    bench_sleep(run_seconds);
+    atomic_store(&bench_running, 0);
+    for (int i = 0; i < planes_num; i++)
+        pthread_join(threads_ids[i], NULL);
+    double elapsed = (double)(bench_now_ns() - start) / 1e9;
+    pthread_barrier_destroy(&bench_barrier);
+    print_bench_report(run_kind == STRESS ? "stress test" : "benchmark", mode->name, planes_stats, planes_num,
+                       elapsed);
+    return stress != NULL ? stress_report() : 0;
+}
+
+// planes fly and wait as in the demo, but without printing, so the results can be compared with the simulation.
+int run_stats(sigset_t *old_signal_mask) {
+    verbose = 0;
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < planes_num; i++) {
+        if (pthread_create(&(threads_ids[i]), NULL, plane_thread, NULL) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            exit(1);
+        }
+        threads_started++;
+    }
+    pthread_sigmask(SIG_SETMASK, old_signal_mask, NULL);
+    bench_sleep(run_seconds);
+    for (int i = 0; i < threads_started; i++)
+        pthread_cancel(threads_ids[i]);
+    for (int i = 0; i < threads_started; i++)
+        pthread_join(threads_ids[i], NULL);
+    threads_started = 0;
+    print_bench_report("statistics", mode->name, planes_stats, planes_num, (double)(bench_now_ns() - start) / 1e9);
+    return 0;
+}
+
+// all planes share one stats entry, so hundreds of thousands of them fit in memory.
+int run_sim() {
+    struct plane_stats *stats = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct plane_stats));
+    if (stats == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    stats->landings = stats->starts = stats->wakeups = 0;
+    histogram_init(&stats->land_wait);
+    histogram_init(&stats->start_wait);
+    uint64_t start = bench_now_ns();
+    if (run_simulation(run_seconds, stats) != 0) {
+        free(stats);
+        return 1;
+    }
+    double real_elapsed = (double)(bench_now_ns() - start) / 1e9;
+    print_bench_report("simulation", "virtual time", stats, 1, run_seconds);
+    printf("Simulated in %.2f s of real time\n", real_elapsed);
+    free(stats);
+    return 0;
+}
+
+// planes are coroutines on a few workers, stats are kept per worker instead of per plane.
+int run_fibers() {
+    fibers_stats = aligned_alloc(CACHE_LINE_SIZE, fibers_workers_num * sizeof(struct plane_stats));
+    if (fibers_stats == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < fibers_workers_num; i++) {
+        fibers_stats[i].landings = fibers_stats[i].starts = fibers_stats[i].wakeups = 0;
+        histogram_init(&fibers_stats[i].land_wait);
+        histogram_init(&fibers_stats[i].start_wait);
+    }
+    if (run_kind != DEMO)
+        verbose = 0;
+    if (run_kind == BENCH || run_kind == STRESS)
+        start_land_utime = 0;
+    sigset_t signal_mask;
+    sigset_t old_signal_mask;
+    sigfillset(&signal_mask);
+    pthread_sigmask(SIG_SETMASK, &signal_mask, &old_signal_mask);
+    uint64_t start = bench_now_ns();
+    int ret = fibers_start(fibers_workers_num, fibers_stats);
+    pthread_sigmask(SIG_SETMASK, &old_signal_mask, NULL);
+    if (ret != 0)
+        return 1;
+    if (run_kind == DEMO)
+        while (1)
+            pause();
+    bench_sleep(run_seconds);
+    fibers_stop();
+    char *kind = run_kind == BENCH ? "benchmark" : run_kind == STRESS ? "stress test" : "statistics";
+    print_bench_report(kind, "fibers", fibers_stats, fibers_workers_num, (double)(bench_now_ns() - start) / 1e9);
+    return stress != NULL ? stress_report() : 0;
+}
+
+void print_wait(char *name, struct latency_histogram *wait) {
+    printf("%s wait: mean %.0f ns, p50 %llu ns, p99 %llu ns, max %llu ns\n", name, histogram_mean(wait),
+           (unsigned long long)histogram_percentile(wait, 0.5), (unsigned long long)histogram_percentile(wait, 0.99),
+           (unsigned long long)wait->max);
+}
+
+void print_bench_report(char *kind, char *mode_name, struct plane_stats *stats, int stats_num, double elapsed) {
+    struct latency_histogram land_wait, start_wait;
+    unsigned long landings = 0, starts = 0, wakeups = 0;
+    histogram_init(&land_wait);
+    histogram_init(&start_wait);
+    for (int i = 0; i < stats_num; i++) {
+        landings += stats[i].landings;
+        starts += stats[i].starts;
+        wakeups += stats[i].wakeups;
+        histogram_merge(&land_wait, &stats[i].land_wait);
+        histogram_merge(&start_wait, &stats[i].start_wait);
+    }
+    printf("Aircraft carrier %s (%s, %d runways): N %d, K %d, %d planes, %.2f s\n", kind, mode_name, runways_num,
+           n, k, planes_num, elapsed);
+    printf("Operations: %lu\n", landings + starts);
+    printf("Throughput: %.1f operations/s\n", (double)(landings + starts) / elapsed);
+    printf("Landings: %lu, starts: %lu\n", landings, starts);
+    printf("Wakeups per operation: %.3f\n", landings + starts == 0 ? 0.0 : (double)wakeups / (double)(landings + starts));
+    print_wait("Land", &land_wait);
+    print_wait("Start", &start_wait);
+}
+
 int read_args(int argc, char *argv[], int *n, int *k, int *planes_num) {
-    if (argc != 4) {
+    if (argc < 4) {
         printf("Incorrect number of arguments.\n");
         return 1;
     }
@@ -176,6 +446,41 @@ int read_args(int argc, char *argv[], int *n, int *k, int *planes_num) {
         printf("Incorrect number of planes. It should be > 0.\n");
         return 1;
     }
+    if (arg_num < argc && strcmp(argv[arg_num], "mutex") == 0) {
+        arg_num++;
+    }
+    else if (arg_num < argc && (strcmp(argv[arg_num], "runways") == 0 || strcmp(argv[arg_num], "handoff") == 0)) {
+        mode = strcmp(argv[arg_num++], "runways") == 0 ? &runways_mode : &handoff_mode;
+        if (arg_num == argc || (runways_num = atoi(argv[arg_num++])) < 1 || runways_num > MAX_RUNWAYS) {
+            printf("Incorrect number of runways. It should be > 0 and <= %d.\n", MAX_RUNWAYS);
+            return 1;
+        }
+        if (mode == &runways_mode && (*n > RUNWAYS_MAX_PLANES || *planes_num > RUNWAYS_MAX_PLANES)) {
+            printf("Incorrect N or number of planes. Runways mode supports at most %d.\n", RUNWAYS_MAX_PLANES);
+            return 1;
+        }
+    }
+    else if (arg_num < argc && strcmp(argv[arg_num], "fibers") == 0) {
+        arg_num++;
+        if (arg_num == argc || (fibers_workers_num = atoi(argv[arg_num++])) < 1) {
+            printf("Incorrect number of worker threads. It should be > 0.\n");
+            return 1;
+        }
+    }
+    if (arg_num < argc && (strcmp(argv[arg_num], "bench") == 0 || strcmp(argv[arg_num], "stress") == 0 ||
+                           strcmp(argv[arg_num], "stats") == 0 || strcmp(argv[arg_num], "sim") == 0)) {
+        run_kind = strcmp(argv[arg_num], "bench") == 0 ? BENCH : strcmp(argv[arg_num], "stress") == 0 ? STRESS :
+                   strcmp(argv[arg_num], "stats") == 0 ? STATS : SIM;
+        arg_num++;
+        if (arg_num == argc || (run_seconds = atof(argv[arg_num++])) <= 0) {
+            printf("Incorrect number of seconds. It should be > 0.\n");
+            return 1;
+        }
+    }
+    if (arg_num != argc) {
+        printf("Incorrect number of arguments.\n");
+        return 1;
+    }
 
     return 0;
 }
@@ -187,14 +492,23 @@ void thread_cleanup(void *args) {
 }
 
 void cleanup() {
-    for (int i = 0; i < planes_num; i++)
+    for (int i = 0; i < threads_started; i++)
         pthread_cancel(threads_ids[i]);
-    for (int i = 0; i < planes_num; i++)
+    for (int i = 0; i < threads_started; i++)
         pthread_join(threads_ids[i], NULL);
+    if (mode->destroy != NULL)
+        mode->destroy();
     pthread_cond_destroy(&start_cond);
     pthread_cond_destroy(&land_cond);
     pthread_mutex_destroy(&aircraft_carrier_mutex);
     pthread_key_delete(aircraft_carrier_locked);
+    fibers_stop();
+    free(threads_ids);
+    free(planes_stats);
+    free(fibers_stats);
+    evlog_close();
+    metrics_destroy();
+    stress_destroy();
 }
 
 void sigint_handler(int signum) {
@@ -0,0 +1,70 @@
+#ifndef AIRCRAFT_CARRIER_MAIN_H
+#define AIRCRAFT_CARRIER_MAIN_H
+
+#include "../common/bench.h"
+#include "../common/evlog.h"
+#include "../common/rng.h"
+#include "../common/pin.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
+#include "../common/lockprof.h"
+
+#define START_LAND_TIME 100000
+#define MAX_RUNWAYS 16
+// runways mode counts planes in 16-bit fields of its deck word.
+#define RUNWAYS_MAX_PLANES 65535
+
+enum carrier_event {
+    EVENT_GOING_TO_LAND,
+    EVENT_GOING_TO_START,
+    EVENT_LANDING,
+    EVENT_STARTING,
+    EVENT_LANDING_ON_RUNWAY,
+    EVENT_STARTING_ON_RUNWAY,
+    EVENTS_NUM
+};
+
+// land and start wait until the plane may use a runway and return its number, free_runway ends the operation.
+struct carrier_mode {
+    char *name;
+    int (*init)();
+    // return the runway of the plane and the number of planes on deck right after it was given.
+    int (*land)(int plane_id, int *on_deck);
+    int (*start)(int plane_id, int *on_deck);
+    void (*free_runway)(int runway);
+    void (*destroy)();
+};
+
+struct plane_stats {
+    unsigned long landings;
+    unsigned long starts;
+    unsigned long wakeups;
+    struct latency_histogram land_wait;
+    struct latency_histogram start_wait;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+enum run_kind {
+    DEMO,
+    BENCH,
+    STRESS,
+    STATS,
+    SIM
+};
+
+extern int n, k, planes_num, runways_num;
+extern int verbose;
+extern unsigned int start_land_utime;
+extern struct plane_stats *planes_stats;
+
+extern struct carrier_mode mutex_mode;
+extern struct carrier_mode runways_mode;
+extern struct carrier_mode handoff_mode;
+
+unsigned int random_utime(unsigned int min, unsigned int max);
+void stress_runway_taken(int plane_id, int runway, int on_deck, int landing);
+void stress_runway_freed(int runway);
+int run_simulation(double seconds, struct plane_stats *stats);
+int fibers_start(int workers_number, struct plane_stats *stats);
+void fibers_stop();
+
+#endif //AIRCRAFT_CARRIER_MAIN_H
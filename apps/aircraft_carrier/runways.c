@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdint.h>
+#include "../common/futex.h"
+#include "main.h"
+
+int runways_init();
+int runways_land(int plane_id, int *on_deck);
+int runways_start(int plane_id, int *on_deck);
+void runways_free_runway(int runway);
+void runways_destroy();
+
+struct carrier_mode runways_mode = {
+        "runways", runways_init, runways_land, runways_start, runways_free_runway, runways_destroy
+};
+
+// whole deck state in one word: planes on deck, busy runways and numbers of planes waiting to land and to start.
+#define DECK_FIELD_BITS 16
+#define DECK_FIELD_MASK ((1ull << DECK_FIELD_BITS) - 1)
+#define ON_DECK_SHIFT 0
+#define RUNWAYS_SHIFT 16
+#define WAITING_LAND_SHIFT 32
+#define WAITING_START_SHIFT 48
+#define DECK_FIELD(state, shift) ((int)(((state) >> (shift)) & DECK_FIELD_MASK))
+
+_Atomic uint64_t deck_state __attribute__((aligned(CACHE_LINE_SIZE)));
+// changed on every freed runway, planes which cannot go sleep on it.
+atomic_int deck_sequence __attribute__((aligned(CACHE_LINE_SIZE)));
+uint64_t all_runways_mask;
+
+int runways_init() {
+    all_runways_mask = (1ull << runways_num) - 1;
+    atomic_init(&deck_state, 0);
+    atomic_init(&deck_sequence, 0);
+    return 0;
+}
+
+int free_runway_no(uint64_t state) {
+    uint64_t busy = (state >> RUNWAYS_SHIFT) & all_runways_mask;
+    return busy == all_runways_mask ? -1 : __builtin_ctzll(~busy);
+}
+
+int can_land(uint64_t state) {
+    int on_deck = DECK_FIELD(state, ON_DECK_SHIFT);
+    return free_runway_no(state) >= 0 && on_deck < n &&
+           !(on_deck >= k && DECK_FIELD(state, WAITING_START_SHIFT) > 0);
+}
+
+int can_start(uint64_t state) {
+    int on_deck = DECK_FIELD(state, ON_DECK_SHIFT);
+    return free_runway_no(state) >= 0 && !(on_deck < k && DECK_FIELD(state, WAITING_LAND_SHIFT) > 0);
+}
+
+// registers the plane as waiting and then tries to move it from waiting to the runway with one CAS.
+int take_runway(int plane_id, int landing, int *on_deck) {
+    int waiting_shift = landing ? WAITING_LAND_SHIFT : WAITING_START_SHIFT;
+    uint64_t state = atomic_fetch_add(&deck_state, 1ull << waiting_shift) + (1ull << waiting_shift);
+    if (verbose)
+        evlog(landing ? EVENT_GOING_TO_LAND : EVENT_GOING_TO_START, DECK_FIELD(state, ON_DECK_SHIFT), plane_id,
+              0, 0, 0);
+    int sequence;
+    while (1) {
+        sequence = atomic_load(&deck_sequence);
+        state = atomic_load(&deck_state);
+        while (landing ? can_land(state) : can_start(state)) {
+            int runway = free_runway_no(state);
+            uint64_t new_state = state - (1ull << waiting_shift) + (1ull << (RUNWAYS_SHIFT + runway));
+            new_state = landing ? new_state + (1ull << ON_DECK_SHIFT) : new_state - (1ull << ON_DECK_SHIFT);
+            if (atomic_compare_exchange_weak(&deck_state, &state, new_state)) {
+                // fewer waiting planes may let someone else use one of the remaining runways.
+                if (free_runway_no(new_state) >= 0 &&
+                    (DECK_FIELD(new_state, WAITING_LAND_SHIFT) > 0 || DECK_FIELD(new_state, WAITING_START_SHIFT) > 0)) {
+                    atomic_fetch_add(&deck_sequence, 1);
+                    futex_wake(&deck_sequence, INT_MAX);
+                }
+                if (verbose)
+                    evlog(landing ? EVENT_LANDING_ON_RUNWAY : EVENT_STARTING_ON_RUNWAY,
+                          DECK_FIELD(new_state, ON_DECK_SHIFT), plane_id, runway, 0, 0);
+                *on_deck = DECK_FIELD(new_state, ON_DECK_SHIFT);
+                return runway;
+            }
+        }
+        futex_wait(&deck_sequence, sequence);
+        planes_stats[plane_id].wakeups++;
+    }
+}
+
+int runways_land(int plane_id, int *on_deck) {
+    return take_runway(plane_id, 1, on_deck);
+}
+
+int runways_start(int plane_id, int *on_deck) {
+    return take_runway(plane_id, 0, on_deck);
+}
+
+void runways_free_runway(int runway) {
+    uint64_t state = atomic_fetch_and(&deck_state, ~(1ull << (RUNWAYS_SHIFT + runway)));
+    atomic_fetch_add(&deck_sequence, 1);
+    if (DECK_FIELD(state, WAITING_LAND_SHIFT) > 0 || DECK_FIELD(state, WAITING_START_SHIFT) > 0)
+        futex_wake(&deck_sequence, INT_MAX);
+}
+
+void runways_destroy() {
+}
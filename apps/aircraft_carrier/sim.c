@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "main.h"
+
+// discrete-event simulation of the carrier in virtual time: the same planes' loop as plane_thread()
+// and the same admission rules as the handoff mode, but every wait is just an event in the calendar.
+enum sim_event_type {
+    WANTS_TO_LAND,
+    WANTS_TO_START,
+    RUNWAY_FREED
+};
+
+struct sim_event {
+    uint64_t time;
+    uint64_t sequence;
+    int plane_id;
+    int runway;
+    enum sim_event_type type;
+};
+
+// binary min-heap ordered by time, ties are broken by insertion order to keep runs reproducible.
+struct sim_calendar {
+    struct sim_event *events;
+    int size;
+    uint64_t next_sequence;
+};
+
+struct sim_queue {
+    int *planes;
+    int head;
+    int size;
+};
+
+struct sim_calendar calendar;
+struct sim_queue sim_land_queue, sim_start_queue;
+uint64_t *wait_since;
+int sim_on_deck;
+int sim_free_runways[MAX_RUNWAYS];
+int sim_free_runways_num;
+uint64_t sim_now;
+
+int event_before(struct sim_event *a, struct sim_event *b) {
+    return a->time < b->time || (a->time == b->time && a->sequence < b->sequence);
+}
+
+void schedule(uint64_t time, int plane_id, int runway, enum sim_event_type type) {
+    int i = calendar.size++;
+    struct sim_event event = {time, calendar.next_sequence++, plane_id, runway, type};
+    while (i > 0 && event_before(&event, &calendar.events[(i - 1) / 2])) {
+        calendar.events[i] = calendar.events[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    calendar.events[i] = event;
+}
+
+struct sim_event next_event() {
+    struct sim_event first = calendar.events[0];
+    struct sim_event last = calendar.events[--calendar.size];
+    int i = 0;
+    while (2 * i + 1 < calendar.size) {
+        int child = 2 * i + 1;
+        if (child + 1 < calendar.size && event_before(&calendar.events[child + 1], &calendar.events[child]))
+            child++;
+        if (!event_before(&calendar.events[child], &last))
+            break;
+        calendar.events[i] = calendar.events[child];
+        i = child;
+    }
+    calendar.events[i] = last;
+    return first;
+}
+
+void queue_put(struct sim_queue *queue, int plane_id) {
+    queue->planes[(queue->head + queue->size++) % planes_num] = plane_id;
+}
+
+int queue_get(struct sim_queue *queue) {
+    int plane_id = queue->planes[queue->head];
+    queue->head = (queue->head + 1) % planes_num;
+    queue->size--;
+    return plane_id;
+}
+
+uint64_t random_ns(unsigned int min_utime, unsigned int max_utime) {
+    return (uint64_t)random_utime(min_utime, max_utime) * 1000;
+}
+
+// the plane gets a runway now, after START_LAND_TIME it frees it and flies or stays on deck for a while.
+void use_runway(struct plane_stats *stats, int plane_id, int landing) {
+    int runway = sim_free_runways[--sim_free_runways_num];
+    sim_on_deck += landing ? 1 : -1;
+    if (landing) {
+        stats->landings++;
+        histogram_record(&stats->land_wait, sim_now - wait_since[plane_id]);
+    }
+    else {
+        stats->starts++;
+        histogram_record(&stats->start_wait, sim_now - wait_since[plane_id]);
+    }
+    uint64_t freed = sim_now + (uint64_t)START_LAND_TIME * 1000;
+    schedule(freed, plane_id, runway, RUNWAY_FREED);
+    schedule(freed + random_ns(500000, 1000000), plane_id, 0, landing ? WANTS_TO_START : WANTS_TO_LAND);
+}
+
+void grant_runways(struct plane_stats *stats) {
+    while (sim_free_runways_num > 0) {
+        struct sim_queue *queue = NULL;
+        if (sim_on_deck < k)
+            queue = sim_land_queue.size > 0 ? &sim_land_queue : sim_start_queue.size > 0 ? &sim_start_queue : NULL;
+        else if (sim_start_queue.size > 0)
+            queue = &sim_start_queue;
+        else if (sim_land_queue.size > 0 && sim_on_deck < n)
+            queue = &sim_land_queue;
+        if (queue == NULL)
+            return;
+        stats->wakeups++;
+        use_runway(stats, queue_get(queue), queue == &sim_land_queue);
+    }
+}
+
+int run_simulation(double seconds, struct plane_stats *stats) {
+    calendar.events = malloc(2 * planes_num * sizeof(struct sim_event));
+    sim_land_queue.planes = malloc(planes_num * sizeof(int));
+    sim_start_queue.planes = malloc(planes_num * sizeof(int));
+    wait_since = malloc(planes_num * sizeof(uint64_t));
+    if (calendar.events == NULL || sim_land_queue.planes == NULL || sim_start_queue.planes == NULL ||
+        wait_since == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    calendar.size = 0;
+    calendar.next_sequence = 0;
+    sim_land_queue.head = sim_land_queue.size = 0;
+    sim_start_queue.head = sim_start_queue.size = 0;
+    sim_on_deck = 0;
+    for (sim_free_runways_num = 0; sim_free_runways_num < runways_num; sim_free_runways_num++)
+        sim_free_runways[sim_free_runways_num] = runways_num - sim_free_runways_num - 1;
+    for (int i = 0; i < planes_num; i++)
+        schedule(random_ns(500000, 1000000), i, 0, WANTS_TO_LAND);
+
+    uint64_t end = (uint64_t)(seconds * 1e9);
+    while (calendar.size > 0 && calendar.events[0].time <= end) {
+        struct sim_event event = next_event();
+        sim_now = event.time;
+        if (event.type == RUNWAY_FREED) {
+            sim_free_runways[sim_free_runways_num++] = event.runway;
+            grant_runways(stats);
+            continue;
+        }
+        int landing = event.type == WANTS_TO_LAND;
+        struct sim_queue *queue = landing ? &sim_land_queue : &sim_start_queue;
+        int can_go = sim_free_runways_num > 0 && queue->size == 0 && (landing ?
+                sim_on_deck < n && !(sim_on_deck >= k && sim_start_queue.size > 0) :
+                !(sim_on_deck < k && sim_land_queue.size > 0));
+        wait_since[event.plane_id] = sim_now;
+        if (can_go) {
+            use_runway(stats, event.plane_id, landing);
+            grant_runways(stats);
+        }
+        else {
+            queue_put(queue, event.plane_id);
+        }
+    }
+
+    free(calendar.events);
+    free(sim_land_queue.planes);
+    free(sim_start_queue.planes);
+    free(wait_since);
+    return 0;
+}
@@ -0,0 +1,127 @@
+#ifndef SYSOPY_BENCH_H
+#define SYSOPY_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#define CACHE_LINE_SIZE 64
+
+// log-linear histogram: 8 sub-buckets per power of two, values above 2^40 ns are clamped.
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_MAX_BITS 40
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS)
+
+struct latency_histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+static inline uint64_t bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline void bench_sleep(double seconds) {
+    struct timespec ts;
+    ts.tv_sec = (time_t)seconds;
+    ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) * 1e9);
+    while (nanosleep(&ts, &ts) != 0)
+        ;
+}
+
+static inline int histogram_bucket(uint64_t value) {
+    if (value >= (1ull << HISTOGRAM_MAX_BITS))
+        value = (1ull << HISTOGRAM_MAX_BITS) - 1;
+    if (value < (1u << HISTOGRAM_SUB_BITS))
+        return (int)value;
+    int msb = 63 - __builtin_clzll(value);
+    return ((msb - HISTOGRAM_SUB_BITS + 1) << HISTOGRAM_SUB_BITS) +
+           (int)((value >> (msb - HISTOGRAM_SUB_BITS)) & ((1u << HISTOGRAM_SUB_BITS) - 1));
+}
+
+static inline uint64_t histogram_bucket_lower(int bucket) {
+    if (bucket < (1 << HISTOGRAM_SUB_BITS))
+        return (uint64_t)bucket;
+    int group = bucket >> HISTOGRAM_SUB_BITS;
+    uint64_t sub = (uint64_t)(bucket & ((1 << HISTOGRAM_SUB_BITS) - 1));
+    return (((uint64_t)1 << HISTOGRAM_SUB_BITS) + sub) << (group - 1);
+}
+
+static inline void histogram_init(struct latency_histogram *histogram) {
+    memset(histogram, 0, sizeof *histogram);
+}
+
+static inline void histogram_record(struct latency_histogram *histogram, uint64_t value) {
+    histogram->count++;
+    histogram->sum += value;
+    if (value > histogram->max)
+        histogram->max = value;
+    histogram->buckets[histogram_bucket(value)]++;
+}
+
+static inline void histogram_merge(struct latency_histogram *dst, const struct latency_histogram *src) {
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+}
+
+static inline double histogram_mean(const struct latency_histogram *histogram) {
+    return histogram->count == 0 ? 0.0 : (double)histogram->sum / (double)histogram->count;
+}
+
+// returns the upper bound of the bucket holding the given quantile (0 < quantile <= 1).
+static inline uint64_t histogram_percentile(const struct latency_histogram *histogram, double quantile) {
+    if (histogram->count == 0)
+        return 0;
+    uint64_t target = (uint64_t)(quantile * (double)histogram->count);
+    if (target == 0)
+        target = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen >= target) {
+            uint64_t upper = i + 1 < HISTOGRAM_BUCKETS ? histogram_bucket_lower(i + 1) - 1 : histogram->max;
+            return upper < histogram->max ? upper : histogram->max;
+        }
+    }
+    return histogram->max;
+}
+
+// prints non-empty power-of-two ranges of the histogram, one per line.
+static inline void histogram_print(const struct latency_histogram *histogram, const char *indent) {
+    uint64_t power_count[HISTOGRAM_MAX_BITS + 1] = {0};
+    for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+        if (histogram->buckets[i] == 0)
+            continue;
+        uint64_t lower = histogram_bucket_lower(i);
+        int power = lower == 0 ? 0 : 64 - __builtin_clzll(lower);
+        power_count[power] += histogram->buckets[i];
+    }
+    for (int power = 0; power <= HISTOGRAM_MAX_BITS; power++) {
+        if (power_count[power] == 0)
+            continue;
+        uint64_t lower = power == 0 ? 0 : 1ull << (power - 1);
+        printf("%s[%12llu ns, %12llu ns) %10llu\n", indent, (unsigned long long)lower,
+               (unsigned long long)(1ull << power), (unsigned long long)power_count[power]);
+    }
+}
+
+// Jain's fairness index: 1 when all values are equal, 1/n when one entity gets everything.
+static inline double jain_index(const double *values, int n) {
+    double sum = 0.0, sum_of_squares = 0.0;
+    for (int i = 0; i < n; i++) {
+        sum += values[i];
+        sum_of_squares += values[i] * values[i];
+    }
+    return sum_of_squares == 0.0 ? 1.0 : (sum * sum) / ((double)n * sum_of_squares);
+}
+
+#endif //SYSOPY_BENCH_H
@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "bench.h"
+#include "evlog.h"
+
+#define EVLOG_RING_SIZE 1024
+#define EVLOG_DRAIN_INTERVAL 0.01
+
+// single-producer single-consumer ring: only the owner thread moves head, only the drainer moves tail.
+struct evlog_ring {
+    atomic_uint head __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned long dropped;
+    atomic_uint tail __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint32_t thread;
+    struct evlog_ring *next;
+    struct evlog_record records[EVLOG_RING_SIZE];
+};
+
+FILE *evlog_file = NULL;
+const char **evlog_formats;
+static __thread struct evlog_ring *evlog_self;
+static _Atomic(struct evlog_ring *) evlog_rings = NULL;
+static atomic_uint evlog_threads_num = 0;
+static atomic_int evlog_running;
+static pthread_t evlog_drainer;
+static unsigned long evlog_written = 0;
+
+// rings are only ever added (with CAS), so the drainer can walk the list without locking.
+static struct evlog_ring *evlog_ring() {
+    if (evlog_self == NULL) {
+        struct evlog_ring *ring = aligned_alloc(CACHE_LINE_SIZE, sizeof(struct evlog_ring));
+        if (ring == NULL)
+            return NULL;
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        ring->dropped = 0;
+        ring->thread = atomic_fetch_add(&evlog_threads_num, 1);
+        ring->next = atomic_load(&evlog_rings);
+        while (!atomic_compare_exchange_weak(&evlog_rings, &ring->next, ring))
+            ;
+        evlog_self = ring;
+    }
+    return evlog_self;
+}
+
+// a full ring drops the event rather than waiting for the drainer.
+void evlog_record(int event, int a0, int a1, int a2, int a3, int a4) {
+    struct evlog_ring *ring = evlog_ring();
+    if (ring == NULL)
+        return;
+    unsigned int head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head - atomic_load_explicit(&ring->tail, memory_order_acquire) == EVLOG_RING_SIZE) {
+        ring->dropped++;
+        return;
+    }
+    struct evlog_record *record = &ring->records[head % EVLOG_RING_SIZE];
+    record->time_ns = bench_now_ns();
+    record->thread = ring->thread;
+    record->event = (uint32_t)event;
+    record->args[0] = a0;
+    record->args[1] = a1;
+    record->args[2] = a2;
+    record->args[3] = a3;
+    record->args[4] = a4;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+static void evlog_drain() {
+    for (struct evlog_ring *ring = atomic_load(&evlog_rings); ring != NULL; ring = ring->next) {
+        unsigned int tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        unsigned int head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        // at most two writes per ring: up to the end of the array and from its beginning.
+        while (tail != head) {
+            unsigned int first = tail % EVLOG_RING_SIZE;
+            unsigned int count = head - tail < EVLOG_RING_SIZE - first ? head - tail : EVLOG_RING_SIZE - first;
+            fwrite(&ring->records[first], sizeof(struct evlog_record), count, evlog_file);
+            evlog_written += count;
+            tail += count;
+        }
+        atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    }
+}
+
+static void *evlog_drainer_thread(void *arg) {
+    while (atomic_load(&evlog_running)) {
+        bench_sleep(EVLOG_DRAIN_INTERVAL);
+        evlog_drain();
+    }
+    return NULL;
+}
+
+int evlog_init(int *argc, char *argv[], const char **formats, int formats_num) {
+    evlog_formats = formats;
+    if (*argc < 3 || strcmp(argv[*argc - 2], "log") != 0)
+        return 0;
+    char *path = argv[*argc - 1];
+    *argc -= 2;
+    argv[*argc] = NULL;
+    if ((evlog_file = fopen(path, "wb")) == NULL) {
+        printf("Error while opening %s occurred.\n", path);
+        return 1;
+    }
+    uint32_t version = EVLOG_VERSION, formats_num_32 = (uint32_t)formats_num;
+    fwrite(EVLOG_MAGIC, 1, 8, evlog_file);
+    fwrite(&version, sizeof version, 1, evlog_file);
+    fwrite(&formats_num_32, sizeof formats_num_32, 1, evlog_file);
+    for (int i = 0; i < formats_num; i++) {
+        uint32_t length = (uint32_t)strlen(formats[i]);
+        fwrite(&length, sizeof length, 1, evlog_file);
+        fwrite(formats[i], 1, length, evlog_file);
+    }
+    // the drainer must not catch the apps' signals.
+    sigset_t signal_mask, old_signal_mask;
+    sigfillset(&signal_mask);
+    pthread_sigmask(SIG_SETMASK, &signal_mask, &old_signal_mask);
+    atomic_store(&evlog_running, 1);
+    int ret = pthread_create(&evlog_drainer, NULL, evlog_drainer_thread, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_signal_mask, NULL);
+    if (ret != 0) {
+        printf("Error while creating new thread occurred.\n");
+        fclose(evlog_file);
+        evlog_file = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+// should be called after the logging threads are joined, so nothing is lost in the last drain.
+void evlog_close() {
+    if (evlog_file == NULL)
+        return;
+    atomic_store(&evlog_running, 0);
+    pthread_join(evlog_drainer, NULL);
+    evlog_drain();
+    unsigned long dropped = 0;
+    for (struct evlog_ring *ring = atomic_load(&evlog_rings); ring != NULL; ring = ring->next)
+        dropped += ring->dropped;
+    fclose(evlog_file);
+    evlog_file = NULL;
+    fprintf(stderr, "Event log: %lu events written, %lu dropped.\n", evlog_written, dropped);
+}
@@ -0,0 +1,41 @@
+#ifndef SYSOPY_EVLOG_H
+#define SYSOPY_EVLOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// binary event log. Every thread writes fixed-size records to its own ring, a drainer thread writes the rings
+// to the file in batches, so logging never takes a lock shared between threads. evlog_format turns the file
+// back into the text the apps would print. Without a log file evlog() just prints the event and flushes stdout;
+// callers must not flush themselves, as that takes the lock of stdout even when logging to a file.
+#define EVLOG_ARGS 5
+#define EVLOG_MAGIC "SYSEVLOG"
+#define EVLOG_VERSION 2
+
+struct evlog_record {
+    uint64_t time_ns;
+    uint32_t thread;
+    uint32_t event;
+    int32_t args[EVLOG_ARGS];
+};
+
+extern FILE *evlog_file;
+extern const char **evlog_formats;
+
+// removes "log <file>" from the end of the arguments and, if it was there, starts logging to the file.
+// formats are printf formats with up to EVLOG_ARGS int arguments, indexed by event id.
+int evlog_init(int *argc, char *argv[], const char **formats, int formats_num);
+void evlog_record(int event, int a0, int a1, int a2, int a3, int a4);
+void evlog_close();
+
+static inline void evlog(int event, int a0, int a1, int a2, int a3, int a4) {
+    if (evlog_file == NULL) {
+        printf(evlog_formats[event], a0, a1, a2, a3, a4);
+        fflush(stdout);
+    }
+    else {
+        evlog_record(event, a0, a1, a2, a3, a4);
+    }
+}
+
+#endif //SYSOPY_EVLOG_H
@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "evlog.h"
+
+// prints the events of an evlog file in time order, as the app would have printed them.
+int compare_records(const void *a, const void *b) {
+    const struct evlog_record *record_a = a, *record_b = b;
+    return record_a->time_ns < record_b->time_ns ? -1 : record_a->time_ns > record_b->time_ns ? 1 : 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2 || argc > 3 || (argc == 3 && strcmp(argv[2], "times") != 0)) {
+        printf("Enter a log file, optionally times to print when each event happened.\n");
+        return 1;
+    }
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        printf("Error while opening %s occurred.\n", argv[1]);
+        return 1;
+    }
+    char magic[8];
+    uint32_t version, formats_num;
+    if (fread(magic, 1, 8, file) != 8 || memcmp(magic, EVLOG_MAGIC, 8) != 0 ||
+        fread(&version, sizeof version, 1, file) != 1 || version != EVLOG_VERSION ||
+        fread(&formats_num, sizeof formats_num, 1, file) != 1) {
+        printf("%s is not an event log.\n", argv[1]);
+        return 1;
+    }
+    char **formats = calloc(formats_num, sizeof(char *));
+    for (uint32_t i = 0; formats != NULL && i < formats_num; i++) {
+        uint32_t length;
+        if (fread(&length, sizeof length, 1, file) != 1 || (formats[i] = calloc(length + 1, 1)) == NULL ||
+            fread(formats[i], 1, length, file) != length) {
+            printf("%s is not an event log.\n", argv[1]);
+            return 1;
+        }
+    }
+
+    size_t records_num = 0, capacity = 1024;
+    struct evlog_record *records = malloc(capacity * sizeof(struct evlog_record));
+    while (records != NULL && fread(&records[records_num], sizeof(struct evlog_record), 1, file) == 1) {
+        if (++records_num == capacity)
+            records = realloc(records, (capacity *= 2) * sizeof(struct evlog_record));
+    }
+    fclose(file);
+    if (records == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    // rings are drained one after another, so only sorting restores the order between threads.
+    qsort(records, records_num, sizeof(struct evlog_record), compare_records);
+    for (size_t i = 0; i < records_num; i++) {
+        struct evlog_record *record = &records[i];
+        if (record->event >= formats_num)
+            continue;
+        if (argc == 3)
+            printf("%12.6f [%u] ", (double)(record->time_ns - records[0].time_ns) / 1e9, record->thread);
+        printf(formats[record->event], record->args[0], record->args[1], record->args[2], record->args[3],
+               record->args[4]);
+    }
+    for (uint32_t i = 0; i < formats_num; i++)
+        free(formats[i]);
+    free(formats);
+    free(records);
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef SYSOPY_FUTEX_H
+#define SYSOPY_FUTEX_H
+
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+// sleeps while *addr == value. Like sem_wait, it is a cancellation point.
+static inline int futex_wait(atomic_int *addr, int value) {
+    int old_type;
+    pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, &old_type);
+    int ret = (int)syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+    pthread_setcanceltype(old_type, NULL);
+    return ret;
+}
+
+static inline int futex_wake(atomic_int *addr, int count) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+// variants for words in memory shared between processes, timeout may be NULL.
+static inline int futex_wait_shared(atomic_int *addr, int value, const struct timespec *timeout) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static inline int futex_wake_shared(atomic_int *addr, int count) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAKE, count, NULL, NULL, 0);
+}
+
+#endif //SYSOPY_FUTEX_H
@@ -0,0 +1,313 @@
+#define LOCKPROF_IMPLEMENTATION
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include "bench.h"
+#include "lockprof.h"
+
+// everything is counted per thread, threads' tables are merged only when the report is printed.
+#define LOCKPROF_SITES 32
+#define LOCKPROF_HELD 16
+#define LOCKPROF_BUCKETS 41
+#define LOCKPROF_SIGNAL_SLOTS 1024
+
+enum lockprof_kind {
+    LOCKPROF_MUTEX,
+    LOCKPROF_COND,
+    LOCKPROF_SEM,
+    LOCKPROF_KINDS
+};
+
+// power-of-two histogram, much smaller than latency_histogram, as there is one per lock per thread.
+struct lockprof_histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[LOCKPROF_BUCKETS];
+};
+
+struct lockprof_site {
+    const char *name;
+    enum lockprof_kind kind;
+    uint64_t acquires;
+    uint64_t contended;
+    uint64_t busy;
+    uint64_t signals;
+    struct lockprof_histogram wait;
+    struct lockprof_histogram hold;
+    struct lockprof_histogram wakeup;
+};
+
+struct lockprof_held {
+    void *lock;
+    struct lockprof_site *site;
+    uint64_t since;
+};
+
+struct lockprof_thread {
+    struct lockprof_site *sites[LOCKPROF_SITES];
+    int sites_num;
+    struct lockprof_site *other_sites[LOCKPROF_KINDS];
+    struct lockprof_held held[LOCKPROF_HELD];
+    int held_num;
+    struct lockprof_thread *next;
+};
+
+static __thread struct lockprof_thread *lockprof_self;
+static struct lockprof_thread *lockprof_threads;
+static pthread_mutex_t lockprof_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+// last signal time per condvar, hashed by address. Collisions only blur the wakeup latency a bit.
+static _Atomic uint64_t lockprof_signal_time[LOCKPROF_SIGNAL_SLOTS];
+
+static void histogram_add(struct lockprof_histogram *histogram, uint64_t value) {
+    histogram->count++;
+    histogram->sum += value;
+    if (value > histogram->max)
+        histogram->max = value;
+    int bucket = value == 0 ? 0 : 64 - __builtin_clzll(value);
+    histogram->buckets[bucket < LOCKPROF_BUCKETS ? bucket : LOCKPROF_BUCKETS - 1]++;
+}
+
+static void histogram_add_all(struct lockprof_histogram *dst, const struct lockprof_histogram *src) {
+    dst->count += src->count;
+    dst->sum += src->sum;
+    if (src->max > dst->max)
+        dst->max = src->max;
+    for (int i = 0; i < LOCKPROF_BUCKETS; i++)
+        dst->buckets[i] += src->buckets[i];
+}
+
+static uint64_t histogram_quantile(const struct lockprof_histogram *histogram, double quantile) {
+    uint64_t target = (uint64_t)(quantile * (double)histogram->count), seen = 0;
+    for (int i = 0; i < LOCKPROF_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen > target || seen == histogram->count)
+            return i == 0 ? 0 : ((1ull << i) - 1 < histogram->max ? (1ull << i) - 1 : histogram->max);
+    }
+    return histogram->max;
+}
+
+static struct lockprof_thread *lockprof_thread() {
+    if (lockprof_self == NULL) {
+        lockprof_self = calloc(1, sizeof(struct lockprof_thread));
+        if (lockprof_self == NULL)
+            abort();
+        pthread_mutex_lock(&lockprof_threads_mutex);
+        lockprof_self->next = lockprof_threads;
+        lockprof_threads = lockprof_self;
+        pthread_mutex_unlock(&lockprof_threads_mutex);
+    }
+    return lockprof_self;
+}
+
+static struct lockprof_site *site_new(const char *name, enum lockprof_kind kind) {
+    struct lockprof_site *site = calloc(1, sizeof(struct lockprof_site));
+    if (site == NULL)
+        abort();
+    site->name = name;
+    site->kind = kind;
+    return site;
+}
+
+// names are string literals, so comparing pointers is enough inside one thread. Once the table is full, new
+// names are counted together per kind as "(other sites)", the sites already there keep their own numbers.
+static struct lockprof_site *lockprof_site(const char *name, enum lockprof_kind kind) {
+    struct lockprof_thread *self = lockprof_thread();
+    for (int i = 0; i < self->sites_num; i++)
+        if (self->sites[i]->name == name)
+            return self->sites[i];
+    if (self->sites_num < LOCKPROF_SITES)
+        return self->sites[self->sites_num++] = site_new(name, kind);
+    if (self->other_sites[kind] == NULL)
+        self->other_sites[kind] = site_new("(other sites)", kind);
+    return self->other_sites[kind];
+}
+
+static void held_push(void *lock, struct lockprof_site *site, uint64_t since) {
+    struct lockprof_thread *self = lockprof_thread();
+    if (self->held_num < LOCKPROF_HELD)
+        self->held[self->held_num++] = (struct lockprof_held){lock, site, since};
+}
+
+// returns the site the lock was taken at, or NULL if this thread did not take it (e.g. a semaphore posted
+// by another thread or a mutex locked before swapcontext on another thread).
+static struct lockprof_site *held_pop(void *lock, uint64_t now) {
+    struct lockprof_thread *self = lockprof_thread();
+    for (int i = self->held_num - 1; i >= 0; i--) {
+        if (self->held[i].lock != lock)
+            continue;
+        struct lockprof_site *site = self->held[i].site;
+        histogram_add(&site->hold, now - self->held[i].since);
+        self->held[i] = self->held[--self->held_num];
+        return site;
+    }
+    return NULL;
+}
+
+static int signal_slot(void *cond) {
+    return (int)(((uintptr_t)cond / sizeof(pthread_cond_t)) % LOCKPROF_SIGNAL_SLOTS);
+}
+
+int lockprof_mutex_lock(pthread_mutex_t *mutex, const char *name) {
+    struct lockprof_site *site = lockprof_site(name, LOCKPROF_MUTEX);
+    uint64_t start = bench_now_ns();
+    int ret = pthread_mutex_trylock(mutex);
+    if (ret == EBUSY) {
+        site->contended++;
+        ret = pthread_mutex_lock(mutex);
+    }
+    uint64_t now = bench_now_ns();
+    site->acquires++;
+    histogram_add(&site->wait, now - start);
+    held_push(mutex, site, now);
+    return ret;
+}
+
+int lockprof_mutex_trylock(pthread_mutex_t *mutex, const char *name) {
+    struct lockprof_site *site = lockprof_site(name, LOCKPROF_MUTEX);
+    int ret = pthread_mutex_trylock(mutex);
+    if (ret == 0) {
+        site->acquires++;
+        held_push(mutex, site, bench_now_ns());
+    }
+    else {
+        site->busy++;
+    }
+    return ret;
+}
+
+int lockprof_mutex_unlock(pthread_mutex_t *mutex) {
+    held_pop(mutex, bench_now_ns());
+    return pthread_mutex_unlock(mutex);
+}
+
+static void cond_woken(pthread_cond_t *cond, pthread_mutex_t *mutex, struct lockprof_site *site,
+                       struct lockprof_site *mutex_site, uint64_t wait_start) {
+    uint64_t now = bench_now_ns();
+    uint64_t signalled = atomic_load_explicit(&lockprof_signal_time[signal_slot(cond)], memory_order_relaxed);
+    site->acquires++;
+    histogram_add(&site->wait, now - wait_start);
+    if (signalled >= wait_start && signalled <= now)
+        histogram_add(&site->wakeup, now - signalled);
+    if (mutex_site != NULL)
+        held_push(mutex, mutex_site, now);
+}
+
+int lockprof_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name) {
+    struct lockprof_site *site = lockprof_site(name, LOCKPROF_COND);
+    uint64_t wait_start = bench_now_ns();
+    struct lockprof_site *mutex_site = held_pop(mutex, wait_start);
+    int ret = pthread_cond_wait(cond, mutex);
+    cond_woken(cond, mutex, site, mutex_site, wait_start);
+    return ret;
+}
+
+int lockprof_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime,
+                            const char *name) {
+    struct lockprof_site *site = lockprof_site(name, LOCKPROF_COND);
+    uint64_t wait_start = bench_now_ns();
+    struct lockprof_site *mutex_site = held_pop(mutex, wait_start);
+    int ret = pthread_cond_timedwait(cond, mutex, abstime);
+    cond_woken(cond, mutex, site, mutex_site, wait_start);
+    return ret;
+}
+
+int lockprof_cond_signal(pthread_cond_t *cond, const char *name) {
+    lockprof_site(name, LOCKPROF_COND)->signals++;
+    atomic_store_explicit(&lockprof_signal_time[signal_slot(cond)], bench_now_ns(), memory_order_relaxed);
+    return pthread_cond_signal(cond);
+}
+
+int lockprof_cond_broadcast(pthread_cond_t *cond, const char *name) {
+    lockprof_site(name, LOCKPROF_COND)->signals++;
+    atomic_store_explicit(&lockprof_signal_time[signal_slot(cond)], bench_now_ns(), memory_order_relaxed);
+    return pthread_cond_broadcast(cond);
+}
+
+int lockprof_sem_wait(sem_t *sem, const char *name) {
+    struct lockprof_site *site = lockprof_site(name, LOCKPROF_SEM);
+    uint64_t start = bench_now_ns();
+    int ret = sem_trywait(sem);
+    if (ret != 0 && errno == EAGAIN) {
+        site->contended++;
+        ret = sem_wait(sem);
+    }
+    uint64_t now = bench_now_ns();
+    site->acquires++;
+    histogram_add(&site->wait, now - start);
+    held_push(sem, site, now);
+    return ret;
+}
+
+int lockprof_sem_post(sem_t *sem) {
+    held_pop(sem, bench_now_ns());
+    return sem_post(sem);
+}
+
+static int site_compare(const void *a, const void *b) {
+    const struct lockprof_site *site_a = *(struct lockprof_site * const *)a;
+    const struct lockprof_site *site_b = *(struct lockprof_site * const *)b;
+    return site_a->wait.sum < site_b->wait.sum ? 1 : site_a->wait.sum > site_b->wait.sum ? -1 : 0;
+}
+
+// runs after atexit handlers, so the apps have already joined their threads.
+__attribute__((destructor)) static void lockprof_report() {
+    static const char *kinds[] = {"mutex", "cond", "sem"};
+    struct lockprof_site *merged[256];
+    int merged_num = 0;
+    pthread_mutex_lock(&lockprof_threads_mutex);
+    for (struct lockprof_thread *thread = lockprof_threads; thread != NULL; thread = thread->next) {
+        for (int i = 0; i < thread->sites_num + LOCKPROF_KINDS; i++) {
+            int other = i - thread->sites_num;
+            struct lockprof_site *site = other < 0 ? thread->sites[i] : thread->other_sites[other], *total = NULL;
+            if (site == NULL)
+                continue;
+            for (int j = 0; j < merged_num && total == NULL; j++)
+                if (merged[j]->kind == site->kind && strcmp(merged[j]->name, site->name) == 0)
+                    total = merged[j];
+            if (total == NULL) {
+                if (merged_num == 256 || (total = calloc(1, sizeof(struct lockprof_site))) == NULL)
+                    continue;
+                total->name = site->name;
+                total->kind = site->kind;
+                merged[merged_num++] = total;
+            }
+            total->acquires += site->acquires;
+            total->contended += site->contended;
+            total->busy += site->busy;
+            total->signals += site->signals;
+            histogram_add_all(&total->wait, &site->wait);
+            histogram_add_all(&total->hold, &site->hold);
+            histogram_add_all(&total->wakeup, &site->wakeup);
+        }
+    }
+    pthread_mutex_unlock(&lockprof_threads_mutex);
+    if (merged_num == 0)
+        return;
+    qsort(merged, merged_num, sizeof(struct lockprof_site *), site_compare);
+
+    // cont% is the share of acquires that had to wait, failed trylocks did not acquire and are counted apart.
+    printf("\nLock profile (times in ns, percentiles are power-of-two bucket bounds):\n");
+    printf("%-5s %-36s %10s %7s %10s %12s %10s %10s %10s %10s %10s %10s\n", "kind", "lock", "acquires", "cont%",
+           "try busy", "wait total", "wait p50", "wait p99", "wait max", "hold p50", "hold p99", "wake p99");
+    for (int i = 0; i < merged_num; i++) {
+        struct lockprof_site *site = merged[i];
+        printf("%-5s %-36.36s %10llu %6.2f%% %10llu %12llu %10llu %10llu %10llu %10llu %10llu %10llu\n",
+               kinds[site->kind], site->name, (unsigned long long)site->acquires,
+               site->acquires == 0 ? 0.0 : 100.0 * (double)site->contended / (double)site->acquires,
+               (unsigned long long)site->busy,
+               (unsigned long long)site->wait.sum, (unsigned long long)histogram_quantile(&site->wait, 0.5),
+               (unsigned long long)histogram_quantile(&site->wait, 0.99), (unsigned long long)site->wait.max,
+               (unsigned long long)histogram_quantile(&site->hold, 0.5),
+               (unsigned long long)histogram_quantile(&site->hold, 0.99),
+               (unsigned long long)histogram_quantile(&site->wakeup, 0.99));
+        if (site->kind == LOCKPROF_COND)
+            printf("%-5s %-36s signals %llu, woken waits %llu\n", "", "", (unsigned long long)site->signals,
+                   (unsigned long long)site->wakeup.count);
+        free(site);
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,40 @@
+#ifndef SYSOPY_LOCKPROF_H
+#define SYSOPY_LOCKPROF_H
+
+// lock-contention profiler. Built with -DLOCKPROF=ON, every pthread mutex, condvar and semaphore call in the apps
+// goes through a wrapper counting acquires, contended acquires, wait and hold times and condvar wakeup latency
+// per lock (grouped by the expression naming it). A table is printed at exit. Without LOCKPROF this header is empty.
+#if defined(LOCKPROF) || defined(LOCKPROF_IMPLEMENTATION)
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <time.h>
+
+int lockprof_mutex_lock(pthread_mutex_t *mutex, const char *name);
+int lockprof_mutex_trylock(pthread_mutex_t *mutex, const char *name);
+int lockprof_mutex_unlock(pthread_mutex_t *mutex);
+int lockprof_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const char *name);
+int lockprof_cond_timedwait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *abstime,
+                            const char *name);
+int lockprof_cond_signal(pthread_cond_t *cond, const char *name);
+int lockprof_cond_broadcast(pthread_cond_t *cond, const char *name);
+int lockprof_sem_wait(sem_t *sem, const char *name);
+int lockprof_sem_post(sem_t *sem);
+
+#endif
+
+#if defined(LOCKPROF) && !defined(LOCKPROF_IMPLEMENTATION)
+
+#define pthread_mutex_lock(mutex) lockprof_mutex_lock(mutex, #mutex)
+#define pthread_mutex_trylock(mutex) lockprof_mutex_trylock(mutex, #mutex)
+#define pthread_mutex_unlock(mutex) lockprof_mutex_unlock(mutex)
+#define pthread_cond_wait(cond, mutex) lockprof_cond_wait(cond, mutex, #cond)
+#define pthread_cond_timedwait(cond, mutex, abstime) lockprof_cond_timedwait(cond, mutex, abstime, #cond)
+#define pthread_cond_signal(cond) lockprof_cond_signal(cond, #cond)
+#define pthread_cond_broadcast(cond) lockprof_cond_broadcast(cond, #cond)
+#define sem_wait(sem) lockprof_sem_wait(sem, #sem)
+#define sem_post(sem) lockprof_sem_post(sem)
+
+#endif
+
+#endif //SYSOPY_LOCKPROF_H
@@ -0,0 +1,211 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "metrics.h"
+
+// with more entities only the range of their rates is shown.
+#define METRICS_VIEW_ENTITIES 8
+#define METRICS_SEGMENT_NAME_LENGTH 64
+
+struct metrics_segment *metrics = NULL;
+size_t metrics_size = 0;
+
+static size_t segment_size(int entities_num) {
+    return sizeof(struct metrics_segment) + entities_num * sizeof(struct metrics_entity);
+}
+
+static void segment_name(char *name, pid_t pid) {
+    snprintf(name, METRICS_SEGMENT_NAME_LENGTH, "%s%d", METRICS_NAME_PREFIX, (int)pid);
+}
+
+void metrics_create(char *app, char *entity, int entities_num, char **counters_names, int counters_num,
+                    char **gauges_names, int gauges_num) {
+    char name[METRICS_SEGMENT_NAME_LENGTH];
+    segment_name(name, getpid());
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0)
+        return;
+    size_t size = segment_size(entities_num);
+    if (ftruncate(fd, size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return;
+    }
+    struct metrics_segment *segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        shm_unlink(name);
+        return;
+    }
+    segment->pid = getpid();
+    segment->entities_num = entities_num;
+    segment->counters_num = counters_num;
+    segment->gauges_num = gauges_num;
+    strncpy(segment->app, app, METRICS_LABEL_LENGTH - 1);
+    strncpy(segment->entity, entity, METRICS_LABEL_LENGTH - 1);
+    for (int i = 0; i < counters_num; i++)
+        strncpy(segment->counters_names[i], counters_names[i], METRICS_LABEL_LENGTH - 1);
+    for (int i = 0; i < gauges_num; i++)
+        strncpy(segment->gauges_names[i], gauges_names[i], METRICS_LABEL_LENGTH - 1);
+    atomic_store_explicit(&segment->magic, METRICS_MAGIC, memory_order_release);
+    metrics = segment;
+    metrics_size = size;
+}
+
+static struct metrics_segment *map_segment(pid_t pid, int writable, size_t *size) {
+    char name[METRICS_SEGMENT_NAME_LENGTH];
+    segment_name(name, pid);
+    int fd = shm_open(name, writable ? O_RDWR : O_RDONLY, 0);
+    if (fd < 0)
+        return NULL;
+    struct stat stat_buffer;
+    if (fstat(fd, &stat_buffer) != 0 || stat_buffer.st_size < (off_t)sizeof(struct metrics_segment)) {
+        close(fd);
+        return NULL;
+    }
+    int protection = writable ? PROT_READ | PROT_WRITE : PROT_READ;
+    struct metrics_segment *segment = mmap(NULL, stat_buffer.st_size, protection, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED)
+        return NULL;
+    if (atomic_load_explicit(&segment->magic, memory_order_acquire) != METRICS_MAGIC ||
+        segment_size(segment->entities_num) > (size_t)stat_buffer.st_size) {
+        munmap(segment, stat_buffer.st_size);
+        return NULL;
+    }
+    *size = stat_buffer.st_size;
+    return segment;
+}
+
+void metrics_attach() {
+    metrics = map_segment(getppid(), 1, &metrics_size);
+}
+
+// only the creator removes the segment, children just unmap it.
+void metrics_destroy() {
+    if (metrics == NULL)
+        return;
+    if (metrics->pid == getpid()) {
+        char name[METRICS_SEGMENT_NAME_LENGTH];
+        segment_name(name, getpid());
+        shm_unlink(name);
+    }
+    munmap(metrics, metrics_size);
+    metrics = NULL;
+}
+
+uint64_t metrics_total(int counter) {
+    uint64_t total = 0;
+    for (int i = 0; metrics != NULL && i < metrics->entities_num; i++)
+        total += atomic_load_explicit(&metrics->entities[i].counters[counter], memory_order_relaxed);
+    return total;
+}
+
+int metrics_view_open(struct metrics_view *view, pid_t pid) {
+    view->pid = pid;
+    view->segment = map_segment(pid, 0, &view->size);
+    if (view->segment == NULL)
+        return 1;
+    int values_num = view->segment->entities_num * view->segment->counters_num;
+    view->previous = calloc(values_num > 0 ? values_num : 1, sizeof(uint64_t));
+    if (view->previous == NULL) {
+        munmap(view->segment, view->size);
+        view->segment = NULL;
+        return 1;
+    }
+    for (int i = 0; i < view->segment->entities_num; i++)
+        for (int j = 0; j < view->segment->counters_num; j++)
+            view->previous[i * view->segment->counters_num + j] =
+                    atomic_load_explicit(&view->segment->entities[i].counters[j], memory_order_relaxed);
+    view->previous_time = bench_now_ns();
+    return 0;
+}
+
+void metrics_view_print(struct metrics_view *view, char *prefix) {
+    struct metrics_segment *segment = view->segment;
+    uint64_t now = bench_now_ns();
+    double elapsed = (double)(now - view->previous_time) / 1e9;
+    if (elapsed <= 0)
+        return;
+    int counters_num = segment->counters_num;
+    double rates[METRICS_VIEW_ENTITIES][METRICS_COUNTERS_MAX];
+    double totals[METRICS_COUNTERS_MAX], min_rates[METRICS_COUNTERS_MAX], max_rates[METRICS_COUNTERS_MAX];
+    for (int j = 0; j < counters_num; j++) {
+        totals[j] = 0;
+        min_rates[j] = -1;
+        max_rates[j] = 0;
+    }
+    for (int i = 0; i < segment->entities_num; i++) {
+        for (int j = 0; j < counters_num; j++) {
+            uint64_t value = atomic_load_explicit(&segment->entities[i].counters[j], memory_order_relaxed);
+            double rate = (double)(value - view->previous[i * counters_num + j]) / elapsed;
+            view->previous[i * counters_num + j] = value;
+            totals[j] += rate;
+            if (min_rates[j] < 0 || rate < min_rates[j])
+                min_rates[j] = rate;
+            if (rate > max_rates[j])
+                max_rates[j] = rate;
+            if (i < METRICS_VIEW_ENTITIES)
+                rates[i][j] = rate;
+        }
+    }
+    view->previous_time = now;
+
+    printf("%s%s %d:", prefix, segment->app, (int)view->pid);
+    char *separator = " ";
+    for (int j = 0; j < counters_num; j++) {
+        printf("%s%s %.1f/s", separator, segment->counters_names[j], totals[j]);
+        if (segment->entities_num > METRICS_VIEW_ENTITIES)
+            printf(" (%.1f-%.1f per %s)", min_rates[j], max_rates[j], segment->entity);
+        separator = ", ";
+    }
+    for (int j = 0; j < segment->gauges_num; j++) {
+        printf("%s%s %lld", separator, segment->gauges_names[j],
+               atomic_load_explicit(&segment->gauges[j], memory_order_relaxed));
+        separator = ", ";
+    }
+    printf("\n");
+    if (segment->entities_num > METRICS_VIEW_ENTITIES)
+        return;
+    for (int i = 0; i < segment->entities_num; i++) {
+        printf("%s  %s %d:", prefix, segment->entity, i);
+        for (int j = 0; j < counters_num; j++)
+            printf("%s%s %.1f/s", j == 0 ? " " : ", ", segment->counters_names[j], rates[i][j]);
+        printf("\n");
+    }
+}
+
+void metrics_view_close(struct metrics_view *view) {
+    if (view->segment == NULL)
+        return;
+    munmap(view->segment, view->size);
+    free(view->previous);
+    view->segment = NULL;
+    view->previous = NULL;
+}
+
+// segments of processes that were killed stay in /dev/shm, they are skipped.
+int metrics_list(pid_t *pids, int max_pids) {
+    DIR *dir = opendir("/dev/shm");
+    if (dir == NULL)
+        return 0;
+    int pids_num = 0;
+    struct dirent *entry;
+    size_t prefix_length = strlen(METRICS_NAME_PREFIX) - 1;
+    while ((entry = readdir(dir)) != NULL && pids_num < max_pids) {
+        if (strncmp(entry->d_name, METRICS_NAME_PREFIX + 1, prefix_length) != 0)
+            continue;
+        pid_t pid = (pid_t)atoi(entry->d_name + prefix_length);
+        if (pid > 0 && (kill(pid, 0) == 0 || errno == EPERM))
+            pids[pids_num++] = pid;
+    }
+    closedir(dir);
+    return pids_num;
+}
@@ -0,0 +1,76 @@
+#ifndef SYSOPY_METRICS_H
+#define SYSOPY_METRICS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include "bench.h"
+
+// live counters of a running app, in /dev/shm/sysopy_metrics_<pid> of the process that created them. Every
+// entity (thread or child process) has its own cache line of counters, updated with relaxed atomics outside
+// of the app's locks, and gauges hold app-wide values like a queue depth. Readers (the launcher's stats command
+// and metrics_view) only map the segment and sample it, so they never slow the app down.
+#define METRICS_NAME_PREFIX "/sysopy_metrics_"
+#define METRICS_MAGIC 0x4d455452
+#define METRICS_COUNTERS_MAX 4
+#define METRICS_GAUGES_MAX 2
+#define METRICS_LABEL_LENGTH 16
+
+struct metrics_entity {
+    atomic_ullong counters[METRICS_COUNTERS_MAX];
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct metrics_segment {
+    // set last, readers ignore the segment until the header is complete.
+    atomic_uint magic;
+    int32_t pid;
+    int32_t entities_num;
+    int32_t counters_num;
+    int32_t gauges_num;
+    char app[METRICS_LABEL_LENGTH];
+    char entity[METRICS_LABEL_LENGTH];
+    char counters_names[METRICS_COUNTERS_MAX][METRICS_LABEL_LENGTH];
+    char gauges_names[METRICS_GAUGES_MAX][METRICS_LABEL_LENGTH];
+    atomic_llong gauges[METRICS_GAUGES_MAX] __attribute__((aligned(CACHE_LINE_SIZE)));
+    struct metrics_entity entities[];
+};
+
+// the segment of this process, NULL if there is none.
+extern struct metrics_segment *metrics;
+
+// creates the segment of the calling process, failing to do so only disables the metrics.
+void metrics_create(char *app, char *entity, int entities_num, char **counters_names, int counters_num,
+                    char **gauges_names, int gauges_num);
+// in a child process, maps the segment of the parent.
+void metrics_attach();
+void metrics_destroy();
+// the sum of a counter over all entities, 0 without a segment.
+uint64_t metrics_total(int counter);
+
+static inline void metrics_count(int entity, int counter) {
+    if (metrics != NULL && entity >= 0 && entity < metrics->entities_num)
+        atomic_fetch_add_explicit(&metrics->entities[entity].counters[counter], 1, memory_order_relaxed);
+}
+
+static inline void metrics_gauge_set(int gauge, long long value) {
+    if (metrics != NULL)
+        atomic_store_explicit(&metrics->gauges[gauge], value, memory_order_relaxed);
+}
+
+// reading side: a view keeps the previous sample, so every print shows the rates since the one before.
+struct metrics_view {
+    pid_t pid;
+    struct metrics_segment *segment;
+    size_t size;
+    uint64_t *previous;
+    uint64_t previous_time;
+};
+
+// returns 1 if the process has no segment.
+int metrics_view_open(struct metrics_view *view, pid_t pid);
+void metrics_view_print(struct metrics_view *view, char *prefix);
+void metrics_view_close(struct metrics_view *view);
+// fills pids with the live processes that have a segment and returns their number.
+int metrics_list(pid_t *pids, int max_pids);
+
+#endif //SYSOPY_METRICS_H
@@ -0,0 +1,59 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include "metrics.h"
+
+#define MAX_VIEWS 64
+
+// prints the rates of the apps' live counters once a second, for one app or for every app that is running.
+// Apps started later are picked up as they appear, apps that exit are dropped after their last rates.
+struct metrics_view views[MAX_VIEWS];
+int views_num = 0;
+
+int find_view(pid_t pid) {
+    for (int i = 0; i < views_num; i++)
+        if (views[i].pid == pid)
+            return i;
+    return -1;
+}
+
+void refresh_views(pid_t only_pid) {
+    pid_t pids[MAX_VIEWS];
+    int pids_num = only_pid > 0 ? 1 : metrics_list(pids, MAX_VIEWS);
+    if (only_pid > 0)
+        pids[0] = only_pid;
+    for (int i = 0; i < views_num; i++) {
+        if (kill(views[i].pid, 0) != 0) {
+            metrics_view_close(&views[i]);
+            views[i--] = views[--views_num];
+        }
+    }
+    for (int i = 0; i < pids_num && views_num < MAX_VIEWS; i++)
+        if (find_view(pids[i]) < 0 && metrics_view_open(&views[views_num], pids[i]) == 0)
+            views_num++;
+}
+
+int main(int argc, char *argv[]) {
+    pid_t only_pid = 0;
+    if (argc > 2 || (argc == 2 && (only_pid = (pid_t)atoi(argv[1])) <= 0)) {
+        printf("Optionally enter the pid of an app, otherwise all running apps are shown.\n");
+        return 1;
+    }
+    refresh_views(only_pid);
+    if (only_pid > 0 && views_num == 0) {
+        printf("Process %d has no metrics.\n", (int)only_pid);
+        return 1;
+    }
+    while (1) {
+        sleep(1);
+        for (int i = 0; i < views_num; i++)
+            metrics_view_print(&views[i], "");
+        if (views_num == 0)
+            printf("No running apps.\n");
+        fflush(stdout);
+        refresh_views(only_pid);
+        if (only_pid > 0 && views_num == 0)
+            return 0;
+    }
+}
@@ -0,0 +1,200 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include "pin.h"
+
+struct pin_cpu {
+    int cpu;
+    int socket;
+    int core;
+    // position among the siblings of the core, 0 for the first hardware thread.
+    int sibling;
+    // position of the core among the cores of the socket.
+    int core_rank;
+};
+
+char *pin_policies_names[] = {"none", "compact", "scatter", "smt-avoid", "list"};
+int pin_policy = PIN_NONE;
+struct pin_cpu pin_order[CPU_SETSIZE];
+int pin_order_size = 0;
+
+int read_topology_value(int cpu, char *name, int fallback) {
+    char path[128];
+    snprintf(path, sizeof path, "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+        return fallback;
+    int value;
+    if (fscanf(file, "%d", &value) != 1)
+        value = fallback;
+    fclose(file);
+    return value;
+}
+
+int compare_compact(const void *a, const void *b) {
+    const struct pin_cpu *x = a, *y = b;
+    if (x->socket != y->socket)
+        return x->socket - y->socket;
+    if (x->core != y->core)
+        return x->core - y->core;
+    return x->sibling - y->sibling;
+}
+
+int compare_scatter(const void *a, const void *b) {
+    const struct pin_cpu *x = a, *y = b;
+    if (x->sibling != y->sibling)
+        return x->sibling - y->sibling;
+    if (x->core_rank != y->core_rank)
+        return x->core_rank - y->core_rank;
+    return x->socket - y->socket;
+}
+
+// reads the topology of the allowed CPUs, in the order of their numbers.
+int read_allowed_cpus(struct pin_cpu *cpus) {
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof allowed, &allowed) != 0) {
+        printf("Error while getting CPU affinity occurred.\n");
+        return -1;
+    }
+    int cpus_num = 0;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+        struct pin_cpu *entry = &cpus[cpus_num++];
+        entry->cpu = cpu;
+        entry->socket = read_topology_value(cpu, "physical_package_id", 0);
+        entry->core = read_topology_value(cpu, "core_id", cpu);
+        entry->sibling = 0;
+        for (int i = 0; i < cpus_num - 1; i++)
+            if (cpus[i].socket == entry->socket && cpus[i].core == entry->core)
+                entry->sibling++;
+    }
+    for (int i = 0; i < cpus_num; i++) {
+        cpus[i].core_rank = 0;
+        for (int j = 0; j < cpus_num; j++)
+            if (cpus[j].socket == cpus[i].socket && cpus[j].sibling == 0 && cpus[j].core < cpus[i].core)
+                cpus[i].core_rank++;
+    }
+    return cpus_num;
+}
+
+// a list like 0,2,4-7, every CPU has to be allowed.
+int parse_cpu_list(char *list, struct pin_cpu *allowed, int allowed_num) {
+    char *position = list;
+    pin_order_size = 0;
+    while (*position != '\0') {
+        char *end;
+        long first = strtol(position, &end, 10), last = first;
+        if (end == position)
+            return 1;
+        if (*end == '-') {
+            position = end + 1;
+            last = strtol(position, &end, 10);
+            if (end == position || last < first)
+                return 1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            int found = 0;
+            for (int i = 0; i < allowed_num && !found; i++) {
+                if (allowed[i].cpu == cpu) {
+                    if (pin_order_size == CPU_SETSIZE)
+                        return 1;
+                    pin_order[pin_order_size++] = allowed[i];
+                    found = 1;
+                }
+            }
+            if (!found)
+                return 1;
+        }
+        if (*end == ',')
+            end++;
+        else if (*end != '\0')
+            return 1;
+        position = end;
+    }
+    return pin_order_size == 0;
+}
+
+int pin_init(int *argc, char *argv[]) {
+    char *policy_name = NULL;
+    for (int i = 1; i + 1 < *argc; i++) {
+        if (strcmp(argv[i], "pin") == 0) {
+            policy_name = argv[i + 1];
+            memmove(&argv[i], &argv[i + 2], (*argc - i - 1) * sizeof(char *));
+            *argc -= 2;
+            break;
+        }
+    }
+    if (policy_name == NULL)
+        return 0;
+
+    static struct pin_cpu allowed[CPU_SETSIZE];
+    int allowed_num = read_allowed_cpus(allowed);
+    if (allowed_num <= 0)
+        return 1;
+    if (strcmp(policy_name, "compact") == 0 || strcmp(policy_name, "smt-avoid") == 0) {
+        pin_policy = policy_name[0] == 'c' ? PIN_COMPACT : PIN_SMT_AVOID;
+        qsort(allowed, allowed_num, sizeof(struct pin_cpu), compare_compact);
+        for (int i = 0; i < allowed_num; i++)
+            if (pin_policy == PIN_COMPACT || allowed[i].sibling == 0)
+                pin_order[pin_order_size++] = allowed[i];
+    }
+    else if (strcmp(policy_name, "scatter") == 0) {
+        pin_policy = PIN_SCATTER;
+        qsort(allowed, allowed_num, sizeof(struct pin_cpu), compare_scatter);
+        memcpy(pin_order, allowed, allowed_num * sizeof(struct pin_cpu));
+        pin_order_size = allowed_num;
+    }
+    else if (parse_cpu_list(policy_name, allowed, allowed_num) == 0) {
+        pin_policy = PIN_LIST;
+    }
+    else {
+        printf("Incorrect pin policy %s. It should be compact, scatter, smt-avoid or a list of allowed CPUs.\n",
+               policy_name);
+        return 1;
+    }
+
+    printf("Pinning %s, CPU order:", pin_policies_names[pin_policy]);
+    for (int i = 0; i < pin_order_size; i++)
+        printf(" %d", pin_order[i].cpu);
+    printf(".\n");
+    fflush(stdout);
+    return 0;
+}
+
+void print_placement(char *entity, int id, struct pin_cpu *cpu) {
+    printf("%s %d pinned to CPU %d (socket %d, core %d, thread %d).\n", entity, id, cpu->cpu, cpu->socket,
+           cpu->core, cpu->sibling);
+}
+
+void pin_thread(char *entity, int id, int position) {
+    if (pin_policy == PIN_NONE)
+        return;
+    struct pin_cpu *cpu = &pin_order[position % pin_order_size];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu->cpu, &set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0) {
+        printf("Error while setting CPU affinity occurred.\n");
+        return;
+    }
+    print_placement(entity, id, cpu);
+}
+
+// the children wait on the spawner's barrier, so they are pinned before they start working.
+void pin_process(pid_t pid, char *entity, int id, int position) {
+    if (pin_policy == PIN_NONE)
+        return;
+    struct pin_cpu *cpu = &pin_order[position % pin_order_size];
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu->cpu, &set);
+    if (sched_setaffinity(pid, sizeof set, &set) != 0) {
+        printf("Error while setting CPU affinity occurred.\n");
+        return;
+    }
+    print_placement(entity, id, cpu);
+}
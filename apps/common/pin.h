@@ -0,0 +1,26 @@
+#ifndef SYSOPY_PIN_H
+#define SYSOPY_PIN_H
+
+#include <sys/types.h>
+
+// pinning the entities of an app (threads or child processes) to CPUs, given as "pin <policy>":
+// compact   - siblings of one core first, then the other cores of the socket, then the next socket,
+// scatter   - consecutive entities on different sockets, then different cores, siblings are used last,
+// smt-avoid - only the first hardware thread of every core, in compact order,
+// a list    - the CPUs in the given order, e.g. 0,2,4-7.
+// Entity i runs on the i-th CPU of the order, wrapping around when there are more entities than CPUs. Only the
+// CPUs the app is allowed to run on are used. The topology comes from /sys/devices/system/cpu.
+enum pin_policy {
+    PIN_NONE, PIN_COMPACT, PIN_SCATTER, PIN_SMT_AVOID, PIN_LIST
+};
+
+extern int pin_policy;
+
+// removes "pin <policy>" from the arguments and prints the chosen order.
+int pin_init(int *argc, char *argv[]);
+// both put the entity with the given id on the CPU at the given position of the order and print the placement.
+// Without a policy they do nothing.
+void pin_thread(char *entity, int id, int position);
+void pin_process(pid_t pid, char *entity, int id, int position);
+
+#endif //SYSOPY_PIN_H
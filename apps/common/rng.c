@@ -0,0 +1,68 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "bench.h"
+#include "rng.h"
+
+uint64_t rng_master_seed = 0;
+__thread uint64_t rng_state[4];
+__thread int rng_seeded = 0;
+atomic_ullong rng_unknown_streams = 1ull << 32;
+
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed_state(uint64_t stream, uint64_t state[4]) {
+    uint64_t x = rng_master_seed ^ splitmix64(&stream);
+    for (int i = 0; i < 4; i++)
+        state[i] = splitmix64(&x);
+}
+
+void rng_seed_thread(uint64_t stream) {
+    rng_seed_state(stream, rng_state);
+    rng_seeded = 1;
+}
+
+void rng_seed_unknown_thread() {
+    rng_seed_thread(atomic_fetch_add(&rng_unknown_streams, 1));
+}
+
+int rng_init(int *argc, char *argv[]) {
+    char *env_seed = getenv(RNG_SEED_ENV);
+    int given = 0;
+    for (int i = 1; i + 1 < *argc; i++) {
+        if (strcmp(argv[i], "seed") == 0) {
+            char *end;
+            rng_master_seed = strtoull(argv[i + 1], &end, 10);
+            if (*end != '\0') {
+                printf("Incorrect seed %s.\n", argv[i + 1]);
+                return 1;
+            }
+            memmove(&argv[i], &argv[i + 2], (*argc - i - 1) * sizeof(char *));
+            *argc -= 2;
+            given = 1;
+            break;
+        }
+    }
+    if (!given && env_seed != NULL) {
+        rng_master_seed = strtoull(env_seed, NULL, 10);
+    }
+    else if (!given) {
+        rng_master_seed = (bench_now_ns() ^ (uint64_t)getpid()) % 1000000000ull;
+        printf("Seed: %llu\n", (unsigned long long)rng_master_seed);
+    }
+    // children started by this process inherit the seed.
+    char seed_string[32];
+    snprintf(seed_string, sizeof seed_string, "%llu", (unsigned long long)rng_master_seed);
+    setenv(RNG_SEED_ENV, seed_string, 1);
+
+    char *child_index = getenv(RNG_CHILD_ENV);
+    rng_seed_thread(child_index != NULL ? strtoull(child_index, NULL, 10) : RNG_MAIN_STREAM);
+    return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef SYSOPY_RNG_H
+#define SYSOPY_RNG_H
+
+#include <stdint.h>
+
+// per-thread xoshiro256** generators. Every stream is derived from one master seed, given as "seed <n>" on the
+// command line (otherwise taken from the clock and printed), so a run can be repeated with the same schedule.
+// Threads seed their stream with the id of their entity, child processes get the seed and their index from
+// the parent through the environment. Nothing is shared between threads, unlike rand().
+#define RNG_MAIN_STREAM UINT64_MAX
+#define RNG_SEED_ENV "SYSOPY_SEED"
+#define RNG_CHILD_ENV "SYSOPY_CHILD_INDEX"
+
+extern uint64_t rng_master_seed;
+extern __thread uint64_t rng_state[4];
+extern __thread int rng_seeded;
+
+// removes "seed <n>" from the arguments and seeds the calling thread, with the child index in a child process.
+int rng_init(int *argc, char *argv[]);
+void rng_seed_thread(uint64_t stream);
+// seeds a state kept outside of the thread, for entities which move between threads.
+void rng_seed_state(uint64_t stream, uint64_t state[4]);
+// for threads that never called rng_seed_thread, their streams depend on the order they get here.
+void rng_seed_unknown_thread();
+
+static inline uint64_t rng_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t rng_next() {
+    if (!rng_seeded)
+        rng_seed_unknown_thread();
+    uint64_t *s = rng_state;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+    return result;
+}
+
+// uniform in [min, max).
+static inline unsigned int rng_range(unsigned int min, unsigned int max) {
+    return min + (unsigned int)(((rng_next() >> 32) * (uint64_t)(max - min)) >> 32);
+}
+
+// uniform in [0, 1).
+static inline double rng_uniform() {
+    return (double)(rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+#endif //SYSOPY_RNG_H
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "bench.h"
+#include "futex.h"
+#include "rng.h"
+#include "spawner.h"
+
+#define BARRIER_NAME_LENGTH 64
+#define READY_TIMEOUT_NS 10000000000ull
+
+struct spawn_barrier {
+    atomic_int ready;
+    atomic_int released;
+};
+
+struct pool_worker {
+    pid_t pid;
+    int pipe_fd;
+};
+
+char *spawn_modes_names[] = {"fork", "posix", "pool"};
+
+extern char **environ;
+
+enum spawn_mode spawner_mode;
+sigset_t spawner_child_mask;
+struct spawn_barrier *barrier = NULL;
+char barrier_name[BARRIER_NAME_LENGTH];
+struct pool_worker *pool = NULL;
+int pool_size = 0, pool_next = 0;
+int spawned_num = 0;
+uint64_t first_spawn_time;
+
+int spawn_parse_mode(char *name) {
+    for (int i = 0; i < (int)(sizeof spawn_modes_names / sizeof spawn_modes_names[0]); i++)
+        if (strcmp(name, spawn_modes_names[i]) == 0)
+            return i;
+    return -1;
+}
+
+void set_child_index(int index) {
+    char index_string[16];
+    snprintf(index_string, sizeof index_string, "%d", index);
+    setenv(RNG_CHILD_ENV, index_string, 1);
+}
+
+// the worker was forked before it knew its role. Reading EOF means the pool was destroyed unused.
+// The role is "<child index> <exe path>".
+void pool_worker_loop(int pipe_fd) {
+    char role[PATH_MAX + 16];
+    ssize_t length = read(pipe_fd, role, sizeof role - 1);
+    if (length <= 0)
+        _exit(0);
+    role[length] = '\0';
+    close(pipe_fd);
+    char *exe_path = strchr(role, ' ');
+    if (exe_path == NULL)
+        _exit(127);
+    *exe_path++ = '\0';
+    set_child_index(atoi(role));
+    execl(exe_path, exe_path, NULL);
+    printf("Error while executing %s occurred.\n", exe_path);
+    _exit(127);
+}
+
+int start_pool(int children_num) {
+    pool = calloc(children_num, sizeof(struct pool_worker));
+    if (pool == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < children_num; i++) {
+        int pipe_fds[2];
+        if (pipe(pipe_fds) != 0) {
+            printf("Error while creating pipe occurred.\n");
+            return 1;
+        }
+        pid_t pid = fork();
+        if (pid < 0) {
+            printf("Error while creating new process occurred.\n");
+            close(pipe_fds[0]);
+            close(pipe_fds[1]);
+            return 1;
+        }
+        if (pid == 0) {
+            sigprocmask(SIG_SETMASK, &spawner_child_mask, NULL);
+            // write ends of the earlier workers would keep them from seeing EOF.
+            for (int j = 0; j < pool_size; j++)
+                close(pool[j].pipe_fd);
+            close(pipe_fds[1]);
+            pool_worker_loop(pipe_fds[0]);
+        }
+        close(pipe_fds[0]);
+        fcntl(pipe_fds[1], F_SETFD, FD_CLOEXEC);
+        pool[pool_size].pid = pid;
+        pool[pool_size].pipe_fd = pipe_fds[1];
+        pool_size++;
+    }
+    return 0;
+}
+
+int spawner_init(enum spawn_mode mode, int children_num, sigset_t *child_mask) {
+    spawner_mode = mode;
+    spawner_child_mask = *child_mask;
+    snprintf(barrier_name, BARRIER_NAME_LENGTH, "/spawn_barrier_%d", (int)getpid());
+    int fd = shm_open(barrier_name, O_CREAT | O_RDWR | O_TRUNC, S_IWUSR | S_IRUSR);
+    if (fd < 0 || ftruncate(fd, sizeof(struct spawn_barrier)) < 0) {
+        printf("Error while creating start barrier occurred.\n");
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+    barrier = mmap(NULL, sizeof(struct spawn_barrier), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (barrier == MAP_FAILED) {
+        barrier = NULL;
+        printf("Error while creating start barrier occurred.\n");
+        return 1;
+    }
+    atomic_store(&barrier->ready, 0);
+    atomic_store(&barrier->released, 0);
+    if (mode == SPAWN_POOL)
+        return start_pool(children_num);
+    return 0;
+}
+
+// the child gets the environment of the parent plus its index.
+pid_t spawn_posix(char *exe_path, int index) {
+    int environ_num = 0;
+    while (environ[environ_num] != NULL)
+        environ_num++;
+    char **child_environ = malloc((environ_num + 2) * sizeof(char *));
+    char index_variable[64];
+    if (child_environ == NULL)
+        return -1;
+    snprintf(index_variable, sizeof index_variable, "%s=%d", RNG_CHILD_ENV, index);
+    memcpy(child_environ, environ, environ_num * sizeof(char *));
+    child_environ[environ_num] = index_variable;
+    child_environ[environ_num + 1] = NULL;
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setsigmask(&attr, &spawner_child_mask);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK);
+    char *child_argv[] = {exe_path, NULL};
+    pid_t pid;
+    int ret = posix_spawn(&pid, exe_path, NULL, &attr, child_argv, child_environ);
+    posix_spawnattr_destroy(&attr);
+    free(child_environ);
+    return ret == 0 ? pid : -1;
+}
+
+pid_t spawner_start(char *exe_path) {
+    if (spawned_num == 0)
+        first_spawn_time = bench_now_ns();
+    pid_t pid = -1;
+    if (spawner_mode == SPAWN_FORK) {
+        pid = fork();
+        if (pid == 0) {
+            sigprocmask(SIG_SETMASK, &spawner_child_mask, NULL);
+            set_child_index(spawned_num);
+            execl(exe_path, exe_path, NULL);
+            _exit(127);
+        }
+    }
+    else if (spawner_mode == SPAWN_POOL && pool_next < pool_size) {
+        struct pool_worker *worker = &pool[pool_next++];
+        // a role shorter than PIPE_BUF is written atomically, the worker gets it with one read.
+        char role[PATH_MAX + 16];
+        int length = snprintf(role, sizeof role, "%d %s", spawned_num, exe_path);
+        if (write(worker->pipe_fd, role, length) == length)
+            pid = worker->pid;
+        close(worker->pipe_fd);
+        worker->pipe_fd = -1;
+    }
+    else {
+        pid = spawn_posix(exe_path, spawned_num);
+    }
+    if (pid > 0)
+        spawned_num++;
+    return pid;
+}
+
+double spawner_release(int *ready_num) {
+    uint64_t deadline = bench_now_ns() + READY_TIMEOUT_NS;
+    int ready;
+    while ((ready = atomic_load(&barrier->ready)) < spawned_num && bench_now_ns() < deadline) {
+        struct timespec timeout = {0, 100000000l};
+        futex_wait_shared(&barrier->ready, ready, &timeout);
+    }
+    double elapsed = spawned_num > 0 ? (double)(bench_now_ns() - first_spawn_time) / 1e9 : 0;
+    atomic_store(&barrier->released, 1);
+    futex_wake_shared(&barrier->released, INT_MAX);
+    *ready_num = ready;
+    return elapsed;
+}
+
+// workers which never got a role see EOF and exit.
+void spawner_destroy() {
+    for (int i = pool_next; i < pool_size; i++) {
+        close(pool[i].pipe_fd);
+        waitpid(pool[i].pid, NULL, 0);
+    }
+    free(pool);
+    pool = NULL;
+    pool_size = pool_next = 0;
+    if (barrier != NULL) {
+        munmap(barrier, sizeof(struct spawn_barrier));
+        shm_unlink(barrier_name);
+        barrier = NULL;
+    }
+}
+
+int spawn_child_index() {
+    char *index = getenv(RNG_CHILD_ENV);
+    return index != NULL ? atoi(index) : -1;
+}
+
+int spawn_barrier_wait() {
+    char name[BARRIER_NAME_LENGTH];
+    snprintf(name, BARRIER_NAME_LENGTH, "/spawn_barrier_%d", (int)getppid());
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return 0;
+    struct spawn_barrier *child_barrier = mmap(NULL, sizeof(struct spawn_barrier), PROT_READ | PROT_WRITE,
+                                               MAP_SHARED, fd, 0);
+    close(fd);
+    if (child_barrier == MAP_FAILED)
+        return 1;
+    atomic_fetch_add(&child_barrier->ready, 1);
+    futex_wake_shared(&child_barrier->ready, 1);
+    while (atomic_load(&child_barrier->released) == 0)
+        futex_wait_shared(&child_barrier->released, 0, NULL);
+    munmap(child_barrier, sizeof(struct spawn_barrier));
+    return 0;
+}
@@ -0,0 +1,34 @@
+#ifndef SYSOPY_SPAWNER_H
+#define SYSOPY_SPAWNER_H
+
+#include <signal.h>
+#include <sys/types.h>
+
+// starting the helper processes of the multi-process apps:
+// fork  - fork and exec for every child, the parent's memory is copied each time,
+// posix - posix_spawn, glibc creates the child with clone(CLONE_VM | CLONE_VFORK), so nothing is copied,
+// pool  - idle workers are forked up front, each one waits on its own pipe for the exe it should become.
+// Children call spawn_barrier_wait once they are attached to the app's resources. The parent learns when all of
+// them are ready from a counter in shared memory and then releases them together.
+enum spawn_mode {
+    SPAWN_FORK, SPAWN_POSIX, SPAWN_POOL
+};
+
+extern char *spawn_modes_names[];
+
+// returns -1 for an unknown name.
+int spawn_parse_mode(char *name);
+int spawner_init(enum spawn_mode mode, int children_num, sigset_t *child_mask);
+pid_t spawner_start(char *exe_path);
+// waits until every started child is ready (or gives up after a while), releases them and returns the time
+// from the first spawner_start in seconds.
+double spawner_release(int *ready_num);
+void spawner_destroy();
+
+// called by a child, blocks until the parent releases all children. Returns at once if the child was not
+// started by the spawner.
+int spawn_barrier_wait();
+// the position of the child among all children of its parent, -1 if it was not started by the spawner.
+int spawn_child_index();
+
+#endif //SYSOPY_SPAWNER_H
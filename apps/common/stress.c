@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "stress.h"
+
+#define STRESS_SEGMENT_NAME_LENGTH 64
+
+struct stress_segment *stress = NULL;
+size_t stress_size = 0;
+
+static void segment_name(char *name, pid_t pid) {
+    snprintf(name, STRESS_SEGMENT_NAME_LENGTH, "%s%d", STRESS_NAME_PREFIX, (int)pid);
+}
+
+int stress_create(int shadows_num) {
+    char name[STRESS_SEGMENT_NAME_LENGTH];
+    segment_name(name, getpid());
+    size_t size = sizeof(struct stress_segment) + shadows_num * sizeof(struct stress_shadow);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd < 0 || ftruncate(fd, size) != 0) {
+        printf("Error while creating stress shadows occurred.\n");
+        if (fd >= 0) {
+            close(fd);
+            shm_unlink(name);
+        }
+        return 1;
+    }
+    struct stress_segment *segment = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        printf("Error while creating stress shadows occurred.\n");
+        shm_unlink(name);
+        return 1;
+    }
+    // a new segment is zeroed, so all shadows start at 0.
+    segment->pid = getpid();
+    segment->shadows_num = shadows_num;
+    stress = segment;
+    stress_size = size;
+    return 0;
+}
+
+void stress_attach() {
+    char name[STRESS_SEGMENT_NAME_LENGTH];
+    segment_name(name, getppid());
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd < 0)
+        return;
+    struct stat stat_buffer;
+    if (fstat(fd, &stat_buffer) != 0 || stat_buffer.st_size < (off_t)sizeof(struct stress_segment)) {
+        close(fd);
+        return;
+    }
+    struct stress_segment *segment = mmap(NULL, stat_buffer.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED)
+        return;
+    stress = segment;
+    stress_size = stat_buffer.st_size;
+}
+
+// only the creator removes the segment, children just unmap it.
+void stress_destroy() {
+    if (stress == NULL)
+        return;
+    if (stress->pid == getpid()) {
+        char name[STRESS_SEGMENT_NAME_LENGTH];
+        segment_name(name, getpid());
+        shm_unlink(name);
+    }
+    munmap(stress, stress_size);
+    stress = NULL;
+}
+
+void stress_violation(char *format, ...) {
+    if (atomic_fetch_add(&stress->violations, 1) != 0)
+        return;
+    va_list args;
+    va_start(args, format);
+    vsnprintf(stress->message, STRESS_MESSAGE_LENGTH, format, args);
+    va_end(args);
+    atomic_store_explicit(&stress->message_ready, 1, memory_order_release);
+}
+
+int stress_report() {
+    unsigned long long violations = atomic_load(&stress->violations);
+    printf("Violations: %llu\n", violations);
+    if (violations > 0 && atomic_load_explicit(&stress->message_ready, memory_order_acquire))
+        printf("Violation #1: %s\n", stress->message);
+    fflush(stdout);
+    return violations > 0;
+}
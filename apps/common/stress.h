@@ -0,0 +1,53 @@
+#ifndef SYSOPY_STRESS_H
+#define SYSOPY_STRESS_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include "bench.h"
+
+// stress mode ("stress <seconds>" in every app): the apps run with as many entities as they are given and without
+// sleeps or printing, while the safety property of their synchronization is checked on shadow counters. A shadow
+// counter is an atomic next to the real state (planes on deck, holders of a printer, ...), changed only while the
+// entity really holds what it counts, so it never runs ahead of the real state and every value out of bounds
+// is a real violation. Violations are counted and the first one is kept with its description.
+// The segment is /dev/shm/sysopy_stress_<pid> of the process that created it, child processes attach to the one
+// of their parent. Without stress mode there is no segment and every check is a single branch.
+#define STRESS_NAME_PREFIX "/sysopy_stress_"
+#define STRESS_MESSAGE_LENGTH 192
+
+struct stress_shadow {
+    atomic_llong value;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct stress_segment {
+    int32_t pid;
+    int32_t shadows_num;
+    atomic_ullong violations;
+    // set once the message of the first violation is complete.
+    atomic_int message_ready;
+    char message[STRESS_MESSAGE_LENGTH];
+    struct stress_shadow shadows[];
+};
+
+// the segment of this process, NULL outside of stress mode.
+extern struct stress_segment *stress;
+
+int stress_create(int shadows_num);
+// in a child process, maps the segment of the parent, if it has one.
+void stress_attach();
+void stress_destroy();
+void stress_violation(char *format, ...) __attribute__((format(printf, 1, 2)));
+// prints the number of violations and the first one, returns 1 if there were any.
+int stress_report();
+
+// returns the new value of the shadow.
+static inline long long stress_add(int shadow, long long delta) {
+    return atomic_fetch_add(&stress->shadows[shadow].value, delta) + delta;
+}
+
+static inline long long stress_load(int shadow) {
+    return atomic_load(&stress->shadows[shadow].value);
+}
+
+#endif //SYSOPY_STRESS_H
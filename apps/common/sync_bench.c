@@ -0,0 +1,269 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <sys/ipc.h>
+#include <sys/sem.h>
+#include <sys/stat.h>
+#include "bench.h"
+#include "futex.h"
+
+// microbenchmarks of the synchronization paths the apps are built on, each running for a fixed time:
+// - lock/unlock and post/wait costs alone and with contending threads (printers, aircraft, table, philosophers),
+// - round trips between two threads handing a token over with a condition variable, a semaphore, a System V
+//   semaphore (consumer_producer's queue) or a bare futex (the lock-free modes).
+// Every result is printed as "<name>: <ns> ns per ..." so the launcher's batch mode can collect it.
+#define DEFAULT_SECONDS 0.5
+#define DEFAULT_THREADS 2
+#define MAX_THREADS 64
+// the clock is read only once in this many iterations.
+#define CHECK_INTERVAL 256
+
+union semun {
+    int val;
+    unsigned short *array;
+};
+
+struct handoff_ops {
+    char *name;
+    int (*init)();
+    void (*post)(int channel);
+    void (*wait)(int channel);
+    void (*destroy)();
+};
+
+double bench_seconds = DEFAULT_SECONDS;
+int threads_num = DEFAULT_THREADS;
+atomic_int stop_flag;
+pthread_barrier_t start_barrier;
+pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+sem_t semaphore;
+atomic_ulong shared_counter;
+unsigned long operations[MAX_THREADS] __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// two channels, 0 from the driving thread to the other one and 1 back.
+pthread_cond_t channel_conds[2] = {PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER};
+int channel_flags[2];
+sem_t channel_sems[2];
+int channel_sem_id = -1;
+atomic_int channel_futexes[2];
+
+int cond_init() {
+    channel_flags[0] = channel_flags[1] = 0;
+    return 0;
+}
+
+void cond_post(int channel) {
+    pthread_mutex_lock(&mutex);
+    channel_flags[channel] = 1;
+    pthread_cond_signal(&channel_conds[channel]);
+    pthread_mutex_unlock(&mutex);
+}
+
+void cond_wait(int channel) {
+    pthread_mutex_lock(&mutex);
+    while (channel_flags[channel] == 0)
+        pthread_cond_wait(&channel_conds[channel], &mutex);
+    channel_flags[channel] = 0;
+    pthread_mutex_unlock(&mutex);
+}
+
+int sem_channels_init() {
+    return sem_init(&channel_sems[0], 0, 0) != 0 || sem_init(&channel_sems[1], 0, 0) != 0;
+}
+
+void sem_channel_post(int channel) {
+    sem_post(&channel_sems[channel]);
+}
+
+void sem_channel_wait(int channel) {
+    while (sem_wait(&channel_sems[channel]) != 0)
+        ;
+}
+
+void sem_channels_destroy() {
+    sem_destroy(&channel_sems[0]);
+    sem_destroy(&channel_sems[1]);
+}
+
+int sysv_init() {
+    channel_sem_id = semget(IPC_PRIVATE, 2, IPC_CREAT | S_IRUSR | S_IWUSR);
+    if (channel_sem_id < 0)
+        return 1;
+    union semun value;
+    value.val = 0;
+    semctl(channel_sem_id, 0, SETVAL, value);
+    semctl(channel_sem_id, 1, SETVAL, value);
+    return 0;
+}
+
+void sysv_post(int channel) {
+    struct sembuf operation = {(unsigned short)channel, 1, 0};
+    semop(channel_sem_id, &operation, 1);
+}
+
+void sysv_wait(int channel) {
+    struct sembuf operation = {(unsigned short)channel, -1, 0};
+    while (semop(channel_sem_id, &operation, 1) != 0)
+        ;
+}
+
+void sysv_destroy() {
+    semctl(channel_sem_id, 0, IPC_RMID);
+}
+
+int futex_channels_init() {
+    atomic_store(&channel_futexes[0], 0);
+    atomic_store(&channel_futexes[1], 0);
+    return 0;
+}
+
+void futex_channel_post(int channel) {
+    atomic_store(&channel_futexes[channel], 1);
+    futex_wake(&channel_futexes[channel], 1);
+}
+
+void futex_channel_wait(int channel) {
+    while (atomic_exchange(&channel_futexes[channel], 0) == 0)
+        futex_wait(&channel_futexes[channel], 0);
+}
+
+struct handoff_ops handoffs[] = {
+        {"Condvar handoff",         cond_init,           cond_post,          cond_wait,          NULL},
+        {"Semaphore handoff",       sem_channels_init,   sem_channel_post,   sem_channel_wait,   sem_channels_destroy},
+        {"SysV semaphore handoff",  sysv_init,           sysv_post,          sysv_wait,          sysv_destroy},
+        {"Futex handoff",           futex_channels_init, futex_channel_post, futex_channel_wait, NULL},
+};
+
+void *handoff_thread(void *arg) {
+    struct handoff_ops *ops = arg;
+    while (1) {
+        ops->wait(0);
+        if (atomic_load(&stop_flag))
+            break;
+        ops->post(1);
+    }
+    return NULL;
+}
+
+// the calling thread drives the round trips and decides when to stop, so the other one is never left waiting.
+int run_handoff(struct handoff_ops *ops) {
+    if (ops->init() != 0) {
+        printf("Error while creating %s occurred.\n", ops->name);
+        return 1;
+    }
+    atomic_store(&stop_flag, 0);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, handoff_thread, ops) != 0) {
+        printf("Error while creating new thread occurred.\n");
+        return 1;
+    }
+    uint64_t start = bench_now_ns(), end = start + (uint64_t)(bench_seconds * 1e9), now = start;
+    unsigned long round_trips = 0;
+    while (1) {
+        ops->post(0);
+        ops->wait(1);
+        if (++round_trips % CHECK_INTERVAL == 0 && (now = bench_now_ns()) >= end)
+            break;
+    }
+    atomic_store(&stop_flag, 1);
+    ops->post(0);
+    pthread_join(thread, NULL);
+    if (ops->destroy != NULL)
+        ops->destroy();
+    printf("%s: %.1f ns per round trip\n", ops->name, (double)(now - start) / (double)round_trips);
+    return 0;
+}
+
+void mutex_operation() {
+    pthread_mutex_lock(&mutex);
+    atomic_fetch_add_explicit(&shared_counter, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&mutex);
+}
+
+void semaphore_operation() {
+    sem_wait(&semaphore);
+    atomic_fetch_add_explicit(&shared_counter, 1, memory_order_relaxed);
+    sem_post(&semaphore);
+}
+
+void cas_operation() {
+    unsigned long value = atomic_load_explicit(&shared_counter, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak(&shared_counter, &value, value + 1))
+        ;
+}
+
+struct loop_args {
+    int id;
+    void (*operation)();
+};
+
+void *loop_thread(void *arg) {
+    struct loop_args *args = arg;
+    unsigned long done = 0;
+    pthread_barrier_wait(&start_barrier);
+    while (!atomic_load_explicit(&stop_flag, memory_order_relaxed)) {
+        for (int i = 0; i < CHECK_INTERVAL; i++)
+            args->operation();
+        done += CHECK_INTERVAL;
+    }
+    operations[args->id] = done;
+    return NULL;
+}
+
+// ns per op is the wall time divided by the operations of all threads, so it falls as long as threads scale.
+int run_loop(char *name, void (*operation)(), int loop_threads_num) {
+    pthread_t threads[MAX_THREADS];
+    struct loop_args args[MAX_THREADS];
+    atomic_store(&stop_flag, 0);
+    pthread_barrier_init(&start_barrier, NULL, loop_threads_num + 1);
+    for (int i = 0; i < loop_threads_num; i++) {
+        args[i].id = i;
+        args[i].operation = operation;
+        if (pthread_create(&threads[i], NULL, loop_thread, &args[i]) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            exit(1);
+        }
+    }
+    pthread_barrier_wait(&start_barrier);
+    uint64_t start = bench_now_ns();
+    bench_sleep(bench_seconds);
+    atomic_store(&stop_flag, 1);
+    unsigned long total = 0;
+    for (int i = 0; i < loop_threads_num; i++) {
+        pthread_join(threads[i], NULL);
+        total += operations[i];
+    }
+    uint64_t elapsed = bench_now_ns() - start;
+    pthread_barrier_destroy(&start_barrier);
+    printf("%s: %.1f ns per op\n", name, total > 0 ? (double)elapsed / (double)total : 0.0);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 3 || (argc > 1 && (bench_seconds = atof(argv[1])) <= 0) ||
+        (argc > 2 && ((threads_num = atoi(argv[2])) < 2 || threads_num > MAX_THREADS))) {
+        printf("Optionally enter seconds per benchmark (default %.1f) and a number of contending threads\n"
+               "(2 to %d, default %d).\n", DEFAULT_SECONDS, MAX_THREADS, DEFAULT_THREADS);
+        return 1;
+    }
+    if (sem_init(&semaphore, 0, 1) != 0) {
+        printf("Error while creating semaphore occurred.\n");
+        return 1;
+    }
+    printf("Sync microbenchmarks, %.2f s each, %d contending threads\n", bench_seconds, threads_num);
+    fflush(stdout);
+    run_loop("Mutex uncontended", mutex_operation, 1);
+    run_loop("Mutex contended", mutex_operation, threads_num);
+    run_loop("Semaphore uncontended", semaphore_operation, 1);
+    run_loop("Semaphore contended", semaphore_operation, threads_num);
+    run_loop("Atomic CAS contended", cas_operation, threads_num);
+    for (int i = 0; i < (int)(sizeof handoffs / sizeof handoffs[0]); i++)
+        if (run_handoff(&handoffs[i]) != 0)
+            return 1;
+    sem_destroy(&semaphore);
+    return 0;
+}
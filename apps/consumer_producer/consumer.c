@@ -10,6 +10,9 @@
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
+#include "../common/spawner.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
 #include "main.h"
 
 void sigint_handler(int signum);
@@ -32,8 +35,6 @@ int main(int argc, char *argv[]) {
     act.sa_handler = sigint_handler;
     sigaction(SIGUSR1, &act, NULL);
 
-    srand(time(NULL));
-
     shm_id = shmget(SHM_KEY, MEM_SIZE, S_IRUSR);
     sem_id = semget(SEM_KEY, 0, S_IWUSR | S_IRUSR);
     if (shm_id < 0 || sem_id < 0) {
@@ -46,6 +47,10 @@ int main(int argc, char *argv[]) {
         printf("Error while accessing shared memory occurred.\n");
         return 1;
     }
+    metrics_attach();
+    stress_attach();
+    int metrics_id = spawn_child_index();
+    spawn_barrier_wait();
     struct sembuf sem_op;
     sem_op.sem_flg = 0;
     int task_index;
@@ -67,19 +72,30 @@ int main(int argc, char *argv[]) {
         if (tasks_num < 0)
             tasks_num += ARRAY_LEN;
 
-        gettimeofday(&tval, NULL);
-        printf("%d %ld.%ld Get task from position %d. Number of waiting tasks: %d.\n", getpid(), tval.tv_sec, tval.tv_usec/1000, task_index, tasks_num);
-        fflush(stdout);
+        if (stress != NULL) {
+            long long taken = stress_add(SHADOW_TAKEN, 1);
+            stress_add(SHADOW_TAKEN_HASH, task_hash(shm->tasks[task_index]));
+            if (taken > stress_load(SHADOW_PUT))
+                stress_violation("%d got task from position %d of an empty queue.", getpid(), task_index);
+        }
+        else {
+            gettimeofday(&tval, NULL);
+            printf("%d %ld.%ld Get task from position %d. Number of waiting tasks: %d.\n", getpid(), tval.tv_sec, tval.tv_usec/1000, task_index, tasks_num);
+            fflush(stdout);
+        }
         sem_op.sem_num = 2;
         sem_op.sem_op = 1;
         if (semop(sem_id, &sem_op, 1) == -1)
             on_host_closed();
+        metrics_count(metrics_id, 1);
+        metrics_gauge_set(0, tasks_num);
         sem_op.sem_num = 1;
         sem_op.sem_op = 1;
         if (semop(sem_id, &sem_op, 1) == -1)
             on_host_closed();
 
-        nanosleep(&delay, NULL);
+        if (stress == NULL)
+            nanosleep(&delay, NULL);
     }
 }
 
@@ -91,6 +107,8 @@ void on_host_closed() {
 void cleanup() {
     if (shm != (void *)-1)
         shmdt(shm);
+    metrics_destroy();
+    stress_destroy();
 }
 
 void sigint_handler(int signum) {
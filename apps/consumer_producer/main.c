@@ -10,18 +10,26 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <time.h>
+#include "../common/rng.h"
+#include "../common/pin.h"
+#include "../common/spawner.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
 #include "main.h"
 
 void sigint_handler(int signum);
 void cleanup();
 int read_args(int argc, char *argv[], int *producers_num, int *consumers_num);
 char *get_app_path(char *app_name, char *main_path);
+int run_stress(double seconds);
 
 int sem_id;
 int shm_id;
 int producers_num, consumers_num;
 pid_t *producers;
 pid_t *consumers;
+int spawn_mode = SPAWN_POSIX;
+double stress_seconds = 0;
 
 int main(int argc, char *argv[]) {
     atexit(cleanup);
@@ -34,12 +42,21 @@ int main(int argc, char *argv[]) {
     sigaction(SIGINT, &act, NULL);
     sigaction(SIGTSTP, &act, NULL);
 
-    char *args_help = "Enter number of producers and number of consumers.\n";
-    if (read_args(argc, argv, &producers_num, &consumers_num) != 0) {
+    char *args_help = "Enter number of producers and number of consumers,\n"
+            "optionally spawn with fork, posix or pool, stress with a number of seconds, seed with a number\n"
+            "and pin with compact, scatter, smt-avoid or a CPU list.\n";
+    if (rng_init(&argc, argv) != 0 || pin_init(&argc, argv) != 0 ||
+        read_args(argc, argv, &producers_num, &consumers_num) != 0) {
         printf(args_help);
         return 1;
     }
 
+    if (stress_seconds > 0 && stress_create(SHADOWS_NUM) != 0)
+        return 1;
+    char *counters_names[] = {"tasks in", "tasks out"};
+    char *gauges_names[] = {"queue depth"};
+    metrics_create("cp", "process", producers_num + consumers_num, counters_names, 2, gauges_names, 1);
+
     shm_id = shmget(SHM_KEY, MEM_SIZE, IPC_CREAT | S_IWUSR | S_IRUSR);
     sem_id = semget(SEM_KEY, 4, IPC_CREAT | S_IWUSR | S_IRUSR);
 
@@ -63,42 +80,93 @@ int main(int argc, char *argv[]) {
     consumers = malloc(consumers_num * sizeof(pid_t));
     for (int i = 0; i < consumers_num; i++)
         consumers[i] = 0;
+    if (spawner_init(spawn_mode, producers_num + consumers_num, &full_mask) != 0)
+        return 1;
     char * producer_exe = get_app_path("cp_producer", argv[0]);
     char * consumer_exe = get_app_path("cp_consumer", argv[0]);
     for (int i = 0; i < producers_num; i++) {
-        pid_t pid = fork();
+        pid_t pid = spawner_start(producer_exe);
         if (pid < 0)
             printf("Error while creating new process occurred.\n");
-        else if (pid == 0) {
-            sigprocmask(SIG_SETMASK, &full_mask, NULL);
-            execl(producer_exe, producer_exe, NULL);
-        }
-        else
+        else {
             producers[i] = pid;
+            pin_process(pid, "Producer", i, i);
+        }
     }
     for (int i = 0; i < consumers_num; i++) {
-        pid_t pid = fork();
+        pid_t pid = spawner_start(consumer_exe);
         if (pid < 0)
             printf("Error while creating new process occurred.\n");
-        else if (pid == 0) {
-            sigprocmask(SIG_SETMASK, &full_mask, NULL);
-            execl(consumer_exe, consumer_exe, NULL);
-        }
-        else
+        else {
             consumers[i] = pid;
+            pin_process(pid, "Consumer", i, producers_num + i);
+        }
     }
+    int ready_num;
+    double ready_time = spawner_release(&ready_num);
+    printf("%d of %d processes ready after %.3f ms (%s spawn).\n", ready_num, producers_num + consumers_num,
+           ready_time * 1e3, spawn_modes_names[spawn_mode]);
+    fflush(stdout);
     free(producer_exe);
     free(consumer_exe);
+    if (stress_seconds > 0)
+        return run_stress(stress_seconds);
 
     while (1)
         pause();
 }
 
+// producers and consumers run without sleeps and printing (they see the stress segment). At the end the queue is
+// locked for good, so the tasks still in it can be compared with the shadows: whatever was put and not taken
+// must be exactly there.
+int run_stress(double seconds) {
+    uint64_t start = bench_now_ns();
+    bench_sleep(seconds);
+    struct sembuf sem_op = {2, -1, 0};
+    while (semop(sem_id, &sem_op, 1) != 0)
+        ;
+    double elapsed = (double)(bench_now_ns() - start) / 1e9;
+    struct shm_mem *shm = shmat(shm_id, NULL, SHM_RDONLY);
+    if (shm == (void *)-1) {
+        printf("Error while accessing shared memory occurred.\n");
+        return 1;
+    }
+    long long queued = stress_load(SHADOW_PUT) - stress_load(SHADOW_TAKEN);
+    long long queued_hash = 0;
+    for (long long i = 0; i < queued && i < ARRAY_LEN; i++)
+        queued_hash += task_hash(shm->tasks[(shm->start_index + i) % ARRAY_LEN]);
+    if (queued < 0 || queued > ARRAY_LEN)
+        stress_violation("%lld tasks are left in a queue of %d.", queued, ARRAY_LEN);
+    else if (queued_hash != stress_load(SHADOW_PUT_HASH) - stress_load(SHADOW_TAKEN_HASH))
+        stress_violation("The %lld tasks left in the queue are not the ones put and not taken.", queued);
+    shmdt(shm);
+
+    uint64_t tasks_in = metrics_total(0), tasks_out = metrics_total(1);
+    printf("Consumer-producer stress test: %d producers, %d consumers, %.2f s\n", producers_num, consumers_num,
+           elapsed);
+    printf("Operations: %llu\n", (unsigned long long)(tasks_in + tasks_out));
+    printf("Throughput: %.1f tasks/s\n", (double)tasks_out / elapsed);
+    printf("Tasks in: %llu, tasks out: %llu, left in queue: %lld\n", (unsigned long long)tasks_in,
+           (unsigned long long)tasks_out, queued);
+    return stress_report();
+}
+
 int read_args(int argc, char *argv[], int *producers_num, int *consumers_num) {
-    if (argc != 3) {
+    if (argc >= 5 && strcmp(argv[argc - 2], "stress") == 0) {
+        if ((stress_seconds = atof(argv[argc - 1])) <= 0) {
+            printf("Incorrect number of seconds. It should be > 0.\n");
+            return 1;
+        }
+        argc -= 2;
+    }
+    if (argc != 3 && !(argc == 5 && strcmp(argv[3], "spawn") == 0)) {
         printf("Incorrect number of arguments.\n");
         return 1;
     }
+    if (argc == 5 && (spawn_mode = spawn_parse_mode(argv[4])) < 0) {
+        printf("Incorrect spawn mode. It should be fork, posix or pool.\n");
+        return 1;
+    }
     int arg_num = 1;
     *producers_num = atoi(argv[arg_num++]);
     if (*producers_num < 1) {
@@ -145,6 +213,9 @@ void cleanup() {
 
     free(producers);
     free(consumers);
+    spawner_destroy();
+    metrics_destroy();
+    stress_destroy();
     if (sem_id >= 0)
         semctl(sem_id, 0, IPC_RMID);
     if (shm_id >= 0)
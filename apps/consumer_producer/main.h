@@ -5,6 +5,12 @@
 #define SEM_KEY 54321
 #define ARRAY_LEN 50
 #define MEM_SIZE (ARRAY_LEN + 2) * sizeof(int)
+// stress shadows, all changed inside the queue's critical section: tasks put and taken, and the sums of their hashes.
+#define SHADOW_PUT 0
+#define SHADOW_TAKEN 1
+#define SHADOW_PUT_HASH 2
+#define SHADOW_TAKEN_HASH 3
+#define SHADOWS_NUM 4
 
 union semun {
     int val;
@@ -17,4 +23,10 @@ struct shm_mem {
     int tasks[ARRAY_LEN];
 };
 
+// 32 bits of a multiplicative hash, so sums of billions of them still fit. A lost task and a duplicated one
+// would have to hash alike to cancel out in the sums.
+static inline long long task_hash(int task) {
+    return (long long)(((unsigned long long)(unsigned int)task * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
 #endif //ZAD2_MAIN_H
@@ -10,6 +10,10 @@
 #include <unistd.h>
 #include <time.h>
 #include <sys/time.h>
+#include "../common/rng.h"
+#include "../common/spawner.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
 #include "main.h"
 
 void sigint_handler(int signum);
@@ -32,7 +36,8 @@ int main(int argc, char *argv[]) {
     act.sa_handler = sigint_handler;
     sigaction(SIGUSR1, &act, NULL);
 
-    srand(time(NULL));
+    if (rng_init(&argc, argv) != 0)
+        return 1;
 
     shm_id = shmget(SHM_KEY, MEM_SIZE, S_IWUSR);
     sem_id = semget(SEM_KEY, 0, S_IWUSR | S_IRUSR);
@@ -46,6 +51,10 @@ int main(int argc, char *argv[]) {
         printf("Error while accessing shared memory occurred.\n");
         return 1;
     }
+    metrics_attach();
+    stress_attach();
+    int metrics_id = spawn_child_index();
+    spawn_barrier_wait();
     struct sembuf sem_op;
     sem_op.sem_flg = 0;
     int new_task_index;
@@ -66,24 +75,35 @@ int main(int argc, char *argv[]) {
         shm->end_index = (shm->end_index + 1) % ARRAY_LEN;
 
 
-        task = rand();
+        task = (int)(rng_next() >> 33);
         shm->tasks[new_task_index] = task;
         tasks_num = shm->end_index - shm->start_index;
         if (tasks_num <= 0)
             tasks_num += ARRAY_LEN;
 
-        gettimeofday(&tval, NULL);
-        printf("%d %ld.%ld Put task on position %d. Number of waiting tasks: %d.\n", getpid(), tval.tv_sec, tval.tv_usec/1000, new_task_index, tasks_num);
-        fflush(stdout);
+        if (stress != NULL) {
+            long long put = stress_add(SHADOW_PUT, 1);
+            stress_add(SHADOW_PUT_HASH, task_hash(task));
+            if (put - stress_load(SHADOW_TAKEN) > ARRAY_LEN)
+                stress_violation("%d put task on position %d of a full queue.", getpid(), new_task_index);
+        }
+        else {
+            gettimeofday(&tval, NULL);
+            printf("%d %ld.%ld Put task on position %d. Number of waiting tasks: %d.\n", getpid(), tval.tv_sec, tval.tv_usec/1000, new_task_index, tasks_num);
+            fflush(stdout);
+        }
         sem_op.sem_num = 2;
         sem_op.sem_op = 1;
         if (semop(sem_id, &sem_op, 1) == -1)
             on_host_closed();
+        metrics_count(metrics_id, 0);
+        metrics_gauge_set(0, tasks_num);
         sem_op.sem_num = 0;
         sem_op.sem_op = 1;
         if (semop(sem_id, &sem_op, 1) == -1)
             on_host_closed();
-        nanosleep(&delay, NULL);
+        if (stress == NULL)
+            nanosleep(&delay, NULL);
     }
 }
 
@@ -95,6 +115,8 @@ void on_host_closed() {
 void cleanup() {
     if (shm != (void *)-1)
         shmdt(shm);
+    metrics_destroy();
+    stress_destroy();
 }
 
 void sigint_handler(int signum) {
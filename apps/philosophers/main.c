@@ -4,36 +4,136 @@
 #include <signal.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "../common/bench.h"
+#include "../common/evlog.h"
+#include "../common/futex.h"
+#include "../common/rng.h"
+#include "../common/pin.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
+#include "../common/lockprof.h"
 
+typedef enum {
+    PROTOCOL_SEMAPHORES, PROTOCOL_ATOMIC
+} Protocol;
+
+enum philosopher_event {
+    EVENT_THINKING,
+    EVENT_GOING_TO_EAT,
+    EVENT_WANTS_FORK,
+    EVENT_HAS_TAKEN_FORK,
+    EVENT_EATING,
+    EVENT_HAS_PUT_FORK,
+    EVENT_HAS_TAKEN_FORKS,
+    EVENT_HAS_PUT_FORKS,
+    EVENTS_NUM
+};
+
+const char *events_formats[] = {
+        "Philosopher #%d is thinking.\n",
+        "Philosopher #%d is going to eat.\n",
+        "Philosopher #%d wants to take #%d fork.\n",
+        "Philosopher #%d has taken #%d fork.\n",
+        "Philosopher #%d is eating.\n",
+        "Philosopher #%d has put #%d fork.\n",
+        "Philosopher #%d has taken #%d and #%d forks.\n",
+        "Philosopher #%d has put #%d and #%d forks.\n"
+};
+
+// 0 - free, 1 - taken, 2 - taken and someone sleeps on it.
+struct atomic_fork {
+    atomic_int state;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct philosopher_stats {
+    unsigned long meals;
+    struct latency_histogram wait;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// with more philosophers only the summary of the benchmark is printed.
+#define REPORT_PHILOSOPHERS 16
+
+int read_args(int argc, char *argv[], Protocol *protocol, double *bench_seconds);
 void cleanup();
 void sigint_handler(int signum);
 void *philosopher_thread(void *arg);
+void *atomic_philosopher_thread(void *arg);
+void *bench_philosopher_thread(void *arg);
 void thread_cleanup(void *args);
+int get_philosopher_id();
+void run_bench(double seconds, sigset_t *old_signal_mask);
+void print_bench_report(double elapsed);
+void take_fork_pair(int left_fork, int right_fork);
+void put_fork(int fork);
+void stress_eat(int philosopher_id);
+void stress_done(int philosopher_id);
 
-sem_t forks[5];
+int philosophers_num = 5;
+sem_t *forks;
 sem_t waiter;
-pthread_t threads_ids[5];
-static pthread_mutex_t printf_fork_mutex[5];
+pthread_t *threads_ids;
+int threads_started = 0;
+pthread_mutex_t *printf_fork_mutex;
 pthread_key_t printf_left_fork_locked;
 pthread_key_t printf_right_fork_locked;
 
+struct atomic_fork *atomic_forks;
+Protocol protocol = PROTOCOL_SEMAPHORES;
+char *protocols_names[] = {"semaphores", "atomic"};
+
+double bench_seconds = 0;
+int stress_mode = 0;
+atomic_int bench_running;
+pthread_barrier_t bench_barrier;
+struct philosopher_stats *philosophers_stats;
+
 int main(int argc, char *argv[]) {
     atexit(cleanup);
     struct sigaction act;
+    memset(&act, 0, sizeof act);
     act.sa_handler = sigint_handler;
     sigaction(SIGINT, &act, NULL);
     sigaction(SIGTSTP, &act, NULL);
-    for (int i = 0; i < 5; i++) {
+
+    char *args_help = "Optionally enter a number of philosophers (default 5), protocol (sem or atomic), then bench\n"
+            "or stress and a number of seconds, and log with a file for binary event log.\n"
+            "Every mode accepts seed with a number and pin with compact, scatter, smt-avoid or a CPU list.\n";
+    if (rng_init(&argc, argv) != 0 || pin_init(&argc, argv) != 0 ||
+        evlog_init(&argc, argv, events_formats, EVENTS_NUM) != 0)
+        return 1;
+    if (read_args(argc, argv, &protocol, &bench_seconds) != 0) {
+        printf(args_help);
+        return 1;
+    }
+    if (stress_mode && stress_create(philosophers_num) != 0)
+        return 1;
+    char *counters_names[] = {"meals"};
+    metrics_create("philosophers", "philosopher", philosophers_num, counters_names, 1, NULL, 0);
+    forks = malloc(philosophers_num * sizeof(sem_t));
+    threads_ids = malloc(philosophers_num * sizeof(pthread_t));
+    printf_fork_mutex = malloc(philosophers_num * sizeof(pthread_mutex_t));
+    atomic_forks = aligned_alloc(CACHE_LINE_SIZE, philosophers_num * sizeof(struct atomic_fork));
+    philosophers_stats = aligned_alloc(CACHE_LINE_SIZE, philosophers_num * sizeof(struct philosopher_stats));
+    if (forks == NULL || threads_ids == NULL || printf_fork_mutex == NULL || atomic_forks == NULL ||
+        philosophers_stats == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < philosophers_num; i++)
+        atomic_init(&atomic_forks[i].state, 0);
+    for (int i = 0; i < philosophers_num; i++) {
         if (sem_init(&(forks[i]), 0, 1) != 0) {
             printf("Error while creating semaphore occurred.\n");
             return 1;
         }
     }
-    if (sem_init(&waiter, 0, 4) != 0) {
+    if (sem_init(&waiter, 0, philosophers_num - 1) != 0) {
         printf("Error while creating semaphore occurred.\n");
         return 1;
     }
-    for (int i = 0; i < 5; i++)
+    for (int i = 0; i < philosophers_num; i++)
         pthread_mutex_init(&printf_fork_mutex[i], NULL);
 
     pthread_key_create(&printf_left_fork_locked, NULL);
@@ -43,11 +143,17 @@ int main(int argc, char *argv[]) {
     sigset_t old_signal_mask;
     sigfillset(&signal_mask);
     pthread_sigmask(SIG_SETMASK, &signal_mask, &old_signal_mask);
-    for (int i = 0; i < 5; i++) {
-        if (pthread_create(&(threads_ids[i]), NULL, philosopher_thread, NULL) != 0) {
+    if (bench_seconds > 0) {
+        run_bench(bench_seconds, &old_signal_mask);
+        return stress != NULL ? stress_report() : 0;
+    }
+    for (int i = 0; i < philosophers_num; i++) {
+        if (pthread_create(&(threads_ids[i]), NULL,
+                           protocol == PROTOCOL_ATOMIC ? atomic_philosopher_thread : philosopher_thread, NULL) != 0) {
             printf("Error while creating new thread occurred.\n");
             break;
         }
+        threads_started++;
     }
     pthread_sigmask(SIG_SETMASK, &old_signal_mask, NULL);
 
@@ -55,67 +161,66 @@ int main(int argc, char *argv[]) {
         pause();
 }
 
+int get_philosopher_id() {
+    for (int i = 0; i < philosophers_num; i++) {
+        if (pthread_equal(threads_ids[i], pthread_self()))
+            return i;
+    }
+    return 0;
+}
+
 void *philosopher_thread(void *arg) {
     pthread_cleanup_push(thread_cleanup, NULL);
-    int philosopher_id = 0;
-    for (int i = 0; i < 5; i++) {
-        if (pthread_equal(threads_ids[i], pthread_self())) {
-            philosopher_id = i;
-            break;
-        }
-    }
+    int philosopher_id = get_philosopher_id();
+    rng_seed_thread(philosopher_id);
+    pin_thread("Philosopher", philosopher_id, philosopher_id);
     unsigned int thinking_utime = 0;
     unsigned int eating_time = 500000;
-    int left_fork = philosopher_id, right_fork = (philosopher_id + 1) % 5;
+    int left_fork = philosopher_id, right_fork = (philosopher_id + 1) % philosophers_num;
     int * left_fork_locked = malloc(sizeof(int));
     int * right_fork_locked = malloc(sizeof(int));
     *left_fork_locked = *right_fork_locked = 0;
     pthread_setspecific(printf_left_fork_locked, left_fork_locked);
     pthread_setspecific(printf_right_fork_locked, right_fork_locked);
     while (1) {
-        printf("Philosopher #%d is thinking.\n", philosopher_id);
-        thinking_utime = ((unsigned)rand() % 500000) + 500000;
+        evlog(EVENT_THINKING, philosopher_id, 0, 0, 0, 0);
+        thinking_utime = rng_range(500000, 1000000);
         usleep(thinking_utime);
 
-        printf("Philosopher #%d is going to eat.\n", philosopher_id);
+        evlog(EVENT_GOING_TO_EAT, philosopher_id, 0, 0, 0, 0);
         sem_wait(&waiter);
 
-        printf("Philosopher #%d wants to take #%d fork.\n", philosopher_id, left_fork);
-        fflush(stdout);
+        evlog(EVENT_WANTS_FORK, philosopher_id, left_fork, 0, 0, 0);
         sem_wait(&forks[left_fork]);
         pthread_mutex_lock(&printf_fork_mutex[left_fork]);
         *left_fork_locked = 1;
-        printf("Philosopher #%d has taken #%d fork.\n", philosopher_id, left_fork);
-        fflush(stdout);
+        evlog(EVENT_HAS_TAKEN_FORK, philosopher_id, left_fork, 0, 0, 0);
         pthread_mutex_unlock(&printf_fork_mutex[left_fork]);
         *left_fork_locked = 0;
 
-        printf("Philosopher #%d wants to take #%d fork.\n", philosopher_id, right_fork);
-        fflush(stdout);
+        evlog(EVENT_WANTS_FORK, philosopher_id, right_fork, 0, 0, 0);
         sem_wait(&forks[right_fork]);
         pthread_mutex_lock(&printf_fork_mutex[right_fork]);
         *right_fork_locked = 1;
-        printf("Philosopher #%d has taken #%d fork.\n", philosopher_id, right_fork);
+        evlog(EVENT_HAS_TAKEN_FORK, philosopher_id, right_fork, 0, 0, 0);
         pthread_mutex_unlock(&printf_fork_mutex[right_fork]);
         *right_fork_locked = 0;
 
-        printf("Philosopher #%d is eating.\n", philosopher_id);
-        fflush(stdout);
+        evlog(EVENT_EATING, philosopher_id, 0, 0, 0, 0);
+        metrics_count(philosopher_id, 0);
         usleep(eating_time);
 
         pthread_mutex_lock(&printf_fork_mutex[left_fork]);
         *left_fork_locked = 1;
         sem_post(&forks[left_fork]);
-        printf("Philosopher #%d has put #%d fork.\n", philosopher_id, left_fork);
-        fflush(stdout);
+        evlog(EVENT_HAS_PUT_FORK, philosopher_id, left_fork, 0, 0, 0);
         pthread_mutex_unlock(&printf_fork_mutex[left_fork]);
         *left_fork_locked = 0;
 
         pthread_mutex_lock(&printf_fork_mutex[right_fork]);
         *right_fork_locked = 1;
         sem_post(&forks[right_fork]);
-        printf("Philosopher #%d has put #%d fork.\n", philosopher_id, right_fork);
-        fflush(stdout);
+        evlog(EVENT_HAS_PUT_FORK, philosopher_id, right_fork, 0, 0, 0);
         pthread_mutex_unlock(&printf_fork_mutex[right_fork]);
         *right_fork_locked = 0;
 
@@ -125,32 +230,250 @@ void *philosopher_thread(void *arg) {
     return NULL;
 }
 
+// forks are taken with a try-lock on the left fork, then on the right one; if the right one is busy,
+// the left one is put back and the philosopher sleeps on the busy fork, so nobody waits holding a fork.
+void *atomic_philosopher_thread(void *arg) {
+    int philosopher_id = get_philosopher_id();
+    rng_seed_thread(philosopher_id);
+    pin_thread("Philosopher", philosopher_id, philosopher_id);
+    unsigned int thinking_utime = 0;
+    unsigned int eating_time = 500000;
+    int left_fork = philosopher_id, right_fork = (philosopher_id + 1) % philosophers_num;
+    while (1) {
+        evlog(EVENT_THINKING, philosopher_id, 0, 0, 0, 0);
+        thinking_utime = rng_range(500000, 1000000);
+        usleep(thinking_utime);
+
+        evlog(EVENT_GOING_TO_EAT, philosopher_id, 0, 0, 0, 0);
+        take_fork_pair(left_fork, right_fork);
+        evlog(EVENT_HAS_TAKEN_FORKS, philosopher_id, left_fork, right_fork, 0, 0);
+        evlog(EVENT_EATING, philosopher_id, 0, 0, 0, 0);
+        metrics_count(philosopher_id, 0);
+        usleep(eating_time);
+
+        put_fork(left_fork);
+        put_fork(right_fork);
+        evlog(EVENT_HAS_PUT_FORKS, philosopher_id, left_fork, right_fork, 0, 0);
+    }
+    return NULL;
+}
+
+int try_take_fork(int fork) {
+    int expected = 0;
+    return atomic_compare_exchange_strong(&atomic_forks[fork].state, &expected, 1);
+}
+
+void wait_for_fork(int fork) {
+    atomic_int *state = &atomic_forks[fork].state;
+    int value;
+    while ((value = atomic_load(state)) != 0) {
+        if (value == 1 && !atomic_compare_exchange_strong(state, &value, 2))
+            continue;
+        futex_wait(state, 2);
+    }
+}
+
+void take_fork_pair(int left_fork, int right_fork) {
+    while (1) {
+        if (!try_take_fork(left_fork)) {
+            wait_for_fork(left_fork);
+            continue;
+        }
+        if (try_take_fork(right_fork))
+            return;
+        put_fork(left_fork);
+        wait_for_fork(right_fork);
+    }
+}
+
+void put_fork(int fork) {
+    if (atomic_exchange(&atomic_forks[fork].state, 0) == 2)
+        futex_wake(&atomic_forks[fork].state, INT_MAX);
+}
+
+// same protocols as philosophers' threads, but without sleeps and printing.
+void *bench_philosopher_thread(void *arg) {
+    int philosopher_id = get_philosopher_id();
+    rng_seed_thread(philosopher_id);
+    pin_thread("Philosopher", philosopher_id, philosopher_id);
+    pthread_barrier_wait(&bench_barrier);
+    int left_fork = philosopher_id, right_fork = (philosopher_id + 1) % philosophers_num;
+    struct philosopher_stats *stats = &philosophers_stats[philosopher_id];
+    uint64_t wait_start;
+    while (atomic_load_explicit(&bench_running, memory_order_relaxed)) {
+        wait_start = bench_now_ns();
+        if (protocol == PROTOCOL_ATOMIC) {
+            take_fork_pair(left_fork, right_fork);
+            histogram_record(&stats->wait, bench_now_ns() - wait_start);
+            stats->meals++;
+            metrics_count(philosopher_id, 0);
+            if (stress != NULL) {
+                stress_eat(philosopher_id);
+                stress_done(philosopher_id);
+            }
+            put_fork(left_fork);
+            put_fork(right_fork);
+            continue;
+        }
+        sem_wait(&waiter);
+        sem_wait(&forks[left_fork]);
+        pthread_mutex_lock(&printf_fork_mutex[left_fork]);
+        pthread_mutex_unlock(&printf_fork_mutex[left_fork]);
+        sem_wait(&forks[right_fork]);
+        pthread_mutex_lock(&printf_fork_mutex[right_fork]);
+        pthread_mutex_unlock(&printf_fork_mutex[right_fork]);
+        histogram_record(&stats->wait, bench_now_ns() - wait_start);
+        stats->meals++;
+        metrics_count(philosopher_id, 0);
+        if (stress != NULL) {
+            stress_eat(philosopher_id);
+            stress_done(philosopher_id);
+        }
+
+        pthread_mutex_lock(&printf_fork_mutex[left_fork]);
+        sem_post(&forks[left_fork]);
+        pthread_mutex_unlock(&printf_fork_mutex[left_fork]);
+        pthread_mutex_lock(&printf_fork_mutex[right_fork]);
+        sem_post(&forks[right_fork]);
+        pthread_mutex_unlock(&printf_fork_mutex[right_fork]);
+        sem_post(&waiter);
+    }
+    return NULL;
+}
+
+// shadow i is 1 while philosopher i eats. Both neighbours eating at once would share a fork; the flag is set
+// before looking at the neighbours and cleared before the forks are put, so at least one of them notices.
+void stress_eat(int philosopher_id) {
+    int left = (philosopher_id + philosophers_num - 1) % philosophers_num;
+    int right = (philosopher_id + 1) % philosophers_num;
+    stress_add(philosopher_id, 1);
+    if (stress_load(left) != 0 || stress_load(right) != 0)
+        stress_violation("Philosopher #%d is eating together with neighbour #%d.", philosopher_id,
+                         stress_load(left) != 0 ? left : right);
+}
+
+void stress_done(int philosopher_id) {
+    stress_add(philosopher_id, -1);
+}
+
+void run_bench(double seconds, sigset_t *old_signal_mask) {
+    for (int i = 0; i < philosophers_num; i++) {
+        philosophers_stats[i].meals = 0;
+        histogram_init(&philosophers_stats[i].wait);
+    }
+    atomic_store(&bench_running, 1);
+    pthread_barrier_init(&bench_barrier, NULL, philosophers_num + 1);
+    for (int i = 0; i < philosophers_num; i++) {
+        if (pthread_create(&(threads_ids[i]), NULL, bench_philosopher_thread, NULL) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            exit(1);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, old_signal_mask, NULL);
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t start = bench_now_ns();
+    bench_sleep(seconds);
+    atomic_store(&bench_running, 0);
+    for (int i = 0; i < philosophers_num; i++)
+        pthread_join(threads_ids[i], NULL);
+    double elapsed = (double)(bench_now_ns() - start) / 1e9;
+    pthread_barrier_destroy(&bench_barrier);
+    print_bench_report(elapsed);
+}
+
+void print_bench_report(double elapsed) {
+    unsigned long total_meals = 0;
+    double *meals = malloc(philosophers_num * sizeof(double));
+    struct latency_histogram total_wait;
+    histogram_init(&total_wait);
+    for (int i = 0; i < philosophers_num; i++) {
+        total_meals += philosophers_stats[i].meals;
+        histogram_merge(&total_wait, &philosophers_stats[i].wait);
+        if (meals != NULL)
+            meals[i] = (double)philosophers_stats[i].meals;
+    }
+    printf("Philosophers %s (%s): %d philosophers, %.2f s\n", stress_mode ? "stress test" : "benchmark",
+           protocols_names[protocol], philosophers_num, elapsed);
+    printf("Operations: %lu\n", total_meals);
+    printf("Throughput: %.1f meals/s\n", (double)total_meals / elapsed);
+    if (meals != NULL)
+        printf("Jain fairness index: %.4f\n", jain_index(meals, philosophers_num));
+    free(meals);
+    printf("Wait: mean %.0f ns, p50 %llu ns, p99 %llu ns, max %llu ns\n", histogram_mean(&total_wait),
+           (unsigned long long)histogram_percentile(&total_wait, 0.5),
+           (unsigned long long)histogram_percentile(&total_wait, 0.99), (unsigned long long)total_wait.max);
+    for (int i = 0; i < philosophers_num && philosophers_num <= REPORT_PHILOSOPHERS; i++) {
+        struct latency_histogram *wait = &philosophers_stats[i].wait;
+        printf("Philosopher #%d: %lu meals, wait mean %.0f ns, p50 %llu ns, p99 %llu ns, max %llu ns\n",
+               i, philosophers_stats[i].meals, histogram_mean(wait),
+               (unsigned long long)histogram_percentile(wait, 0.5),
+               (unsigned long long)histogram_percentile(wait, 0.99), (unsigned long long)wait->max);
+        histogram_print(wait, "    ");
+    }
+}
+
+int read_args(int argc, char *argv[], Protocol *protocol, double *bench_seconds) {
+    *protocol = PROTOCOL_SEMAPHORES;
+    *bench_seconds = 0;
+    int arg_num = 1;
+    if (arg_num < argc && atoi(argv[arg_num]) != 0) {
+        philosophers_num = atoi(argv[arg_num++]);
+        if (philosophers_num < 2) {
+            printf("Incorrect number of philosophers. It should be > 1.\n");
+            return 1;
+        }
+    }
+    if (arg_num < argc && strcmp(argv[arg_num], "sem") == 0) {
+        arg_num++;
+    }
+    else if (arg_num < argc && strcmp(argv[arg_num], "atomic") == 0) {
+        *protocol = PROTOCOL_ATOMIC;
+        arg_num++;
+    }
+    if (arg_num == argc)
+        return 0;
+    if (argc - arg_num != 2 || (strcmp(argv[arg_num], "bench") != 0 && strcmp(argv[arg_num], "stress") != 0)) {
+        printf("Incorrect arguments.\n");
+        return 1;
+    }
+    stress_mode = strcmp(argv[arg_num], "stress") == 0;
+    *bench_seconds = atof(argv[arg_num + 1]);
+    if (*bench_seconds <= 0) {
+        printf("Incorrect number of seconds. It should be > 0.\n");
+        return 1;
+    }
+
+    return 0;
+}
+
 void cleanup() {
-    for (int i = 0; i < 5; i++)
+    for (int i = 0; i < threads_started; i++)
         pthread_cancel(threads_ids[i]);
-    for (int i = 0; i < 5; i++)
+    for (int i = 0; i < threads_started; i++)
         pthread_join(threads_ids[i], NULL);
-    for (int i = 0; i < 5; i++) {
+    for (int i = 0; forks != NULL && printf_fork_mutex != NULL && i < philosophers_num; i++) {
         pthread_mutex_destroy(&printf_fork_mutex[i]);
         sem_destroy(&forks[i]);
     }
     sem_destroy(&waiter);
     pthread_key_delete(printf_left_fork_locked);
     pthread_key_delete(printf_right_fork_locked);
+    free(forks);
+    free(threads_ids);
+    free(printf_fork_mutex);
+    free(atomic_forks);
+    free(philosophers_stats);
+    evlog_close();
+    metrics_destroy();
+    stress_destroy();
 }
 
 void thread_cleanup(void *args) {
-    int philosopher_id = 0;
-    for (int i = 0; i < 5; i++) {
-        if (pthread_equal(threads_ids[i], pthread_self())) {
-            philosopher_id = i;
-            break;
-        }
-    }
+    int philosopher_id = get_philosopher_id();
     if (*(int *)pthread_getspecific(printf_left_fork_locked) == 1)
         pthread_mutex_unlock(&printf_fork_mutex[philosopher_id]);
     if (*(int *)pthread_getspecific(printf_right_fork_locked) == 1)
-        pthread_mutex_unlock(&printf_fork_mutex[(philosopher_id + 1) % 5]);
+        pthread_mutex_unlock(&printf_fork_mutex[(philosopher_id + 1) % philosophers_num]);
     free(pthread_getspecific(printf_left_fork_locked));
     free(pthread_getspecific(printf_right_fork_locked));
 }
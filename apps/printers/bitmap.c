@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "../common/bench.h"
+#include "../common/futex.h"
+#include "main.h"
+
+int bitmap_reserve_printer(int id);
+void bitmap_release_printer(int id, int printer_no);
+
+struct printer_allocator bitmap_allocator = {
+        "bitmap", bitmap_init, bitmap_reserve_printer, bitmap_release_printer, bitmap_destroy
+};
+
+// bit set - printer is free. Waiters sleep on bitmap_sequence, which changes on every release.
+_Atomic uint64_t *free_printers_bitmap;
+int bitmap_words;
+atomic_int bitmap_sequence __attribute__((aligned(CACHE_LINE_SIZE)));
+atomic_int bitmap_waiters __attribute__((aligned(CACHE_LINE_SIZE)));
+
+int bitmap_init() {
+    bitmap_words = (printers_num + 63) / 64;
+    free_printers_bitmap = aligned_alloc(CACHE_LINE_SIZE,
+                                         ((bitmap_words * sizeof(uint64_t) + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE);
+    if (free_printers_bitmap == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < bitmap_words; i++) {
+        int bits = printers_num - i * 64;
+        atomic_init(&free_printers_bitmap[i], bits >= 64 ? UINT64_MAX : (1ull << bits) - 1);
+    }
+    atomic_init(&bitmap_sequence, 0);
+    atomic_init(&bitmap_waiters, 0);
+    return 0;
+}
+
+int bitmap_claim_printer(int start_word) {
+    for (int n = 0; n < bitmap_words; n++) {
+        int word = (start_word + n) % bitmap_words;
+        uint64_t bits = atomic_load_explicit(&free_printers_bitmap[word], memory_order_relaxed);
+        while (bits != 0) {
+            int bit = __builtin_ctzll(bits);
+            if (atomic_compare_exchange_weak_explicit(&free_printers_bitmap[word], &bits, bits & ~(1ull << bit),
+                                                      memory_order_acquire, memory_order_relaxed))
+                return word * 64 + bit;
+        }
+    }
+    return -1;
+}
+
+int bitmap_reserve_printer(int id) {
+    // processes start searching from different words, so they do not all fight for the first one.
+    int start_word = id % bitmap_words;
+    int printer_no;
+    if (verbose)
+        evlog(EVENT_WAITING_FOR_PRINTER, id, 0, 0, 0, 0);
+    while ((printer_no = bitmap_claim_printer(start_word)) < 0) {
+        int sequence = atomic_load(&bitmap_sequence);
+        atomic_fetch_add(&bitmap_waiters, 1);
+        printer_no = bitmap_claim_printer(start_word);
+        if (printer_no < 0)
+            futex_wait(&bitmap_sequence, sequence);
+        atomic_fetch_sub(&bitmap_waiters, 1);
+        if (printer_no >= 0)
+            break;
+    }
+    printers[printer_no] = id;
+    if (verbose)
+        evlog(EVENT_USING_PRINTER, id, printer_no, 0, 0, 0);
+    return printer_no;
+}
+
+void bitmap_put_printer(int printer_no) {
+    atomic_fetch_or_explicit(&free_printers_bitmap[printer_no / 64], 1ull << (printer_no % 64), memory_order_release);
+}
+
+void bitmap_release_printer(int id, int printer_no) {
+    printers[printer_no] = -1;
+    bitmap_put_printer(printer_no);
+    atomic_fetch_add(&bitmap_sequence, 1);
+    if (atomic_load(&bitmap_waiters) > 0)
+        futex_wake(&bitmap_sequence, 1);
+    if (verbose)
+        evlog(EVENT_RELEASED_PRINTER, id, printer_no, 0, 0, 0);
+}
+
+void bitmap_destroy() {
+    free(free_printers_bitmap);
+}
@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "../common/bench.h"
+#include "../common/futex.h"
+#include "main.h"
+
+int fifo_init();
+int fifo_reserve_printer(int id);
+void fifo_release_printer(int id, int printer_no);
+void fifo_destroy();
+
+struct printer_allocator fifo_allocator = {
+        "fifo", fifo_init, fifo_reserve_printer, fifo_release_printer, fifo_destroy
+};
+
+// every reservation takes a ticket and every release admits exactly the next ticket, so printers are handed out
+// in ticket order and newcomers cannot overtake waiters. Ticket t sleeps on its own slot t % slots_num; the
+// admitted printer is then taken from the free bitmap, which always holds one for every admitted ticket.
+struct wait_slot {
+    atomic_int sequence;
+    atomic_int waiters;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct wait_slot *wait_slots;
+unsigned int wait_slots_mask;
+atomic_uint next_ticket __attribute__((aligned(CACHE_LINE_SIZE)));
+atomic_uint now_serving __attribute__((aligned(CACHE_LINE_SIZE)));
+
+int fifo_init() {
+    if (bitmap_init() != 0)
+        return 1;
+    // at most processes_num tickets wait at once, so two waiters never share a slot.
+    unsigned int slots_num = 1;
+    while (slots_num < (unsigned)processes_num)
+        slots_num <<= 1;
+    wait_slots = aligned_alloc(CACHE_LINE_SIZE, slots_num * sizeof(struct wait_slot));
+    if (wait_slots == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        bitmap_destroy();
+        return 1;
+    }
+    wait_slots_mask = slots_num - 1;
+    for (unsigned int i = 0; i < slots_num; i++) {
+        atomic_init(&wait_slots[i].sequence, 0);
+        atomic_init(&wait_slots[i].waiters, 0);
+    }
+    atomic_init(&next_ticket, 0);
+    atomic_init(&now_serving, (unsigned)printers_num);
+    return 0;
+}
+
+int fifo_reserve_printer(int id) {
+    unsigned int ticket = atomic_fetch_add(&next_ticket, 1);
+    if (verbose)
+        evlog(EVENT_WAITING_FOR_PRINTER, id, 0, 0, 0, 0);
+    if ((int)(atomic_load(&now_serving) - ticket) <= 0) {
+        struct wait_slot *slot = &wait_slots[ticket & wait_slots_mask];
+        atomic_fetch_add(&slot->waiters, 1);
+        while (1) {
+            int sequence = atomic_load(&slot->sequence);
+            if ((int)(atomic_load(&now_serving) - ticket) > 0)
+                break;
+            futex_wait(&slot->sequence, sequence);
+        }
+        atomic_fetch_sub(&slot->waiters, 1);
+    }
+    int printer_no;
+    while ((printer_no = bitmap_claim_printer(id % bitmap_words)) < 0)
+        ;
+    printers[printer_no] = id;
+    if (verbose)
+        evlog(EVENT_USING_PRINTER, id, printer_no, 0, 0, 0);
+    return printer_no;
+}
+
+void fifo_release_printer(int id, int printer_no) {
+    printers[printer_no] = -1;
+    bitmap_put_printer(printer_no);
+    unsigned int ticket = atomic_fetch_add(&now_serving, 1);
+    struct wait_slot *slot = &wait_slots[ticket & wait_slots_mask];
+    atomic_fetch_add(&slot->sequence, 1);
+    if (atomic_load(&slot->waiters) > 0)
+        futex_wake(&slot->sequence, INT_MAX);
+    if (verbose)
+        evlog(EVENT_RELEASED_PRINTER, id, printer_no, 0, 0, 0);
+}
+
+void fifo_destroy() {
+    free(wait_slots);
+    bitmap_destroy();
+}
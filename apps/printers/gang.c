@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include "main.h"
+
+int gang_init();
+int gang_reserve_printer(int id);
+void gang_release_printer(int id, int printer_no);
+void gang_destroy();
+
+struct printer_allocator gang_allocator = {
+        "gang", gang_init, gang_reserve_printer, gang_release_printer, gang_destroy,
+        gang_reserve_printers, gang_release_printers
+};
+
+// waiters are served strictly in arrival order: a request for many printers blocks smaller requests queued
+// after it, so it cannot starve. Free printers are kept on a stack, so a request costs O(k).
+struct gang_waiter {
+    int k;
+    int *printers_no;
+    int granted;
+    pthread_cond_t cond;
+    struct gang_waiter *next;
+};
+
+pthread_mutex_t gang_mutex;
+int *free_printers_stack;
+int free_printers_num;
+struct gang_waiter *gang_head = NULL, *gang_tail = NULL;
+
+int gang_init() {
+    free_printers_stack = malloc(printers_num * sizeof(int));
+    if (free_printers_stack == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < printers_num; i++)
+        free_printers_stack[i] = printers_num - 1 - i;
+    free_printers_num = printers_num;
+    gang_head = gang_tail = NULL;
+    pthread_mutex_init(&gang_mutex, NULL);
+    return 0;
+}
+
+void take_printers(int id, int k, int *printers_no) {
+    for (int i = 0; i < k; i++) {
+        printers_no[i] = free_printers_stack[--free_printers_num];
+        printers[printers_no[i]] = id;
+    }
+}
+
+void grant_waiters() {
+    while (gang_head != NULL && free_printers_num >= gang_head->k) {
+        struct gang_waiter *waiter = gang_head;
+        take_printers(-2, waiter->k, waiter->printers_no);
+        waiter->granted = 1;
+        gang_head = waiter->next;
+        if (gang_head == NULL)
+            gang_tail = NULL;
+        pthread_cond_signal(&waiter->cond);
+    }
+}
+
+void put_printers(int k, int *printers_no) {
+    for (int i = 0; i < k; i++) {
+        printers[printers_no[i]] = -1;
+        free_printers_stack[free_printers_num++] = printers_no[i];
+    }
+    grant_waiters();
+}
+
+// runs when a waiting process is cancelled: leave the queue, or give back printers granted in the meantime.
+void gang_wait_cleanup(void *arg) {
+    struct gang_waiter *waiter = arg;
+    if (waiter->granted) {
+        put_printers(waiter->k, waiter->printers_no);
+    }
+    else {
+        struct gang_waiter *previous = NULL;
+        for (struct gang_waiter *it = gang_head; it != NULL; previous = it, it = it->next) {
+            if (it == waiter) {
+                if (previous == NULL)
+                    gang_head = it->next;
+                else
+                    previous->next = it->next;
+                if (gang_tail == it)
+                    gang_tail = previous;
+                break;
+            }
+        }
+        grant_waiters();
+    }
+    pthread_cond_destroy(&waiter->cond);
+    pthread_mutex_unlock(&gang_mutex);
+}
+
+// printing is a cancellation point, so nothing is logged with gang_mutex locked: the events use only the
+// arguments and the printers given to the caller.
+int gang_reserve_printers(int id, int k, int *printers_no) {
+    if (k < 1 || k > printers_num || k > GANG_MAX_PRINTERS)
+        return -1;
+    if (verbose)
+        evlog(EVENT_WAITING_FOR_PRINTERS, id, k, 0, 0, 0);
+    pthread_mutex_lock(&gang_mutex);
+    if (gang_head == NULL && free_printers_num >= k) {
+        take_printers(id, k, printers_no);
+    }
+    else {
+        struct gang_waiter waiter = {k, printers_no, 0};
+        pthread_cond_init(&waiter.cond, NULL);
+        waiter.next = NULL;
+        if (gang_tail == NULL)
+            gang_head = &waiter;
+        else
+            gang_tail->next = &waiter;
+        gang_tail = &waiter;
+        pthread_cleanup_push(gang_wait_cleanup, &waiter);
+        while (!waiter.granted)
+            pthread_cond_wait(&waiter.cond, &gang_mutex);
+        pthread_cleanup_pop(0);
+        pthread_cond_destroy(&waiter.cond);
+        for (int i = 0; i < k; i++)
+            printers[printers_no[i]] = id;
+    }
+    pthread_mutex_unlock(&gang_mutex);
+    if (verbose) {
+        evlog(EVENT_USING_PRINTERS + k - 1, id, printers_no[0], k > 1 ? printers_no[1] : 0,
+              k > 2 ? printers_no[2] : 0, k > 3 ? printers_no[3] : 0);
+    }
+    return 0;
+}
+
+void gang_release_printers(int id, int k, int *printers_no) {
+    pthread_mutex_lock(&gang_mutex);
+    put_printers(k, printers_no);
+    pthread_mutex_unlock(&gang_mutex);
+    if (verbose)
+        evlog(EVENT_RELEASED_PRINTERS, id, k, 0, 0, 0);
+}
+
+int gang_reserve_printer(int id) {
+    int printer_no;
+    gang_reserve_printers(id, 1, &printer_no);
+    return printer_no;
+}
+
+void gang_release_printer(int id, int printer_no) {
+    gang_release_printers(id, 1, &printer_no);
+}
+
+void gang_destroy() {
+    pthread_mutex_destroy(&gang_mutex);
+    free(free_printers_stack);
+}
@@ -0,0 +1,340 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include "../common/bench.h"
+#include "main.h"
+
+#define JOBS_LOAD 0.9
+#define SMALL_JOB_MIN_UTIME 100
+#define SMALL_JOB_MAX_UTIME 500
+#define LARGE_JOB_MIN_UTIME 2000
+#define LARGE_JOB_MAX_UTIME 10000
+#define LARGE_JOBS_PERCENT 20
+#define IDLE_UTIME 1000
+
+typedef enum {
+    POLICY_RANDOM, POLICY_ROUND_ROBIN, POLICY_JSQ, POLICY_POWER_OF_TWO, POLICY_LEAST_WORK, POLICIES_NUM
+} Policy;
+
+struct job {
+    unsigned int size_utime;
+    // time of submission after the start of the run.
+    uint64_t arrival_ns;
+    uint64_t submit_ns;
+    uint64_t complete_ns;
+    struct job *next;
+};
+
+struct printer_queue {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    struct job *head;
+    struct job *tail;
+    atomic_int length;
+    atomic_long work_left_utime;
+    uint64_t busy_ns;
+    unsigned long steals;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct jobs_result {
+    Policy policy;
+    double makespan;
+    double utilization;
+    unsigned long steals;
+    struct latency_histogram latency;
+};
+
+void *job_printer_thread(void *arg);
+void *job_submitter_thread(void *arg);
+int run_policy(Policy policy, struct jobs_result *result);
+void print_jobs_result(struct jobs_result *result);
+
+char *policies_names[] = {"random", "rr", "jsq", "p2c", "lwl"};
+char *policies_descriptions[] = {"random", "round-robin", "join-shortest-queue", "power-of-two-choices",
+                                 "least-work-left"};
+
+struct printer_queue *printer_queues;
+struct job *jobs;
+int jobs_total, jobs_steal;
+Policy jobs_policy;
+atomic_int jobs_completed;
+atomic_uint round_robin_counter;
+uint64_t jobs_start_ns;
+
+void push_job(struct printer_queue *queue, struct job *job) {
+    pthread_mutex_lock(&queue->mutex);
+    job->next = NULL;
+    if (queue->tail == NULL)
+        queue->head = job;
+    else
+        queue->tail->next = job;
+    queue->tail = job;
+    atomic_fetch_add(&queue->length, 1);
+    atomic_fetch_add(&queue->work_left_utime, job->size_utime);
+    pthread_cond_signal(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+// removes the first waiting job; work left is decreased only after the job is printed.
+struct job *pop_job(struct printer_queue *queue) {
+    struct job *job = queue->head;
+    if (job != NULL) {
+        queue->head = job->next;
+        if (queue->head == NULL)
+            queue->tail = NULL;
+        atomic_fetch_sub(&queue->length, 1);
+    }
+    return job;
+}
+
+struct job *steal_job(int printer_no) {
+    for (int i = 1; i < printers_num; i++) {
+        struct printer_queue *victim = &printer_queues[(printer_no + i) % printers_num];
+        if (atomic_load_explicit(&victim->length, memory_order_relaxed) == 0)
+            continue;
+        if (pthread_mutex_trylock(&victim->mutex) != 0)
+            continue;
+        struct job *job = pop_job(victim);
+        if (job != NULL)
+            atomic_fetch_sub(&victim->work_left_utime, job->size_utime);
+        pthread_mutex_unlock(&victim->mutex);
+        if (job != NULL)
+            return job;
+    }
+    return NULL;
+}
+
+void wait_for_job(struct printer_queue *queue) {
+    struct timespec deadline;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->head == NULL) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += IDLE_UTIME * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&queue->cond, &queue->mutex, &deadline);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+void *job_printer_thread(void *arg) {
+    int printer_no = (int)(intptr_t)arg;
+    struct printer_queue *queue = &printer_queues[printer_no];
+    pin_thread("Printer", printer_no, printer_no);
+    struct job *job;
+    int own;
+    while (atomic_load(&jobs_completed) < jobs_total) {
+        pthread_mutex_lock(&queue->mutex);
+        job = pop_job(queue);
+        pthread_mutex_unlock(&queue->mutex);
+        own = job != NULL;
+        if (job == NULL && jobs_steal && (job = steal_job(printer_no)) != NULL)
+            queue->steals++;
+        if (job == NULL) {
+            wait_for_job(queue);
+            continue;
+        }
+        uint64_t start = bench_now_ns();
+        usleep(job->size_utime);
+        job->complete_ns = bench_now_ns();
+        queue->busy_ns += job->complete_ns - start;
+        if (own)
+            atomic_fetch_sub(&queue->work_left_utime, job->size_utime);
+        atomic_fetch_add(&jobs_completed, 1);
+    }
+    return NULL;
+}
+
+int dispatch_job() {
+    int best = 0;
+    switch (jobs_policy) {
+        case POLICY_RANDOM:
+            return (int)rng_range(0, printers_num);
+        case POLICY_ROUND_ROBIN:
+            return (int)(atomic_fetch_add(&round_robin_counter, 1) % (unsigned)printers_num);
+        case POLICY_JSQ:
+            for (int i = 1; i < printers_num; i++)
+                if (atomic_load(&printer_queues[i].length) < atomic_load(&printer_queues[best].length))
+                    best = i;
+            return best;
+        case POLICY_POWER_OF_TWO: {
+            int first = (int)rng_range(0, printers_num), second = (int)rng_range(0, printers_num);
+            return atomic_load(&printer_queues[second].length) < atomic_load(&printer_queues[first].length) ?
+                   second : first;
+        }
+        case POLICY_LEAST_WORK:
+            for (int i = 1; i < printers_num; i++)
+                if (atomic_load(&printer_queues[i].work_left_utime) <
+                    atomic_load(&printer_queues[best].work_left_utime))
+                    best = i;
+            return best;
+        default:
+            return 0;
+    }
+}
+
+// submitter i submits jobs i, i + processes_num, ... at their arrival times. Its stream is used only by the
+// random choices of the policy, so every policy gets the same jobs at the same times.
+void *job_submitter_thread(void *arg) {
+    int submitter_no = (int)(intptr_t)arg;
+    rng_seed_thread(submitter_no);
+    pin_thread("Submitter", submitter_no, printers_num + submitter_no);
+    for (int i = submitter_no; i < jobs_total; i += processes_num) {
+        uint64_t next_submit = jobs_start_ns + jobs[i].arrival_ns;
+        uint64_t now = bench_now_ns();
+        if (next_submit > now)
+            usleep((unsigned)((next_submit - now) / 1000));
+        jobs[i].submit_ns = bench_now_ns();
+        push_job(&printer_queues[dispatch_job()], &jobs[i]);
+    }
+    return NULL;
+}
+
+int run_policy(Policy policy, struct jobs_result *result) {
+    pthread_t *printer_threads = malloc(printers_num * sizeof(pthread_t));
+    pthread_t *submitter_threads = malloc(processes_num * sizeof(pthread_t));
+    if (printer_threads == NULL || submitter_threads == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    jobs_policy = policy;
+    atomic_store(&jobs_completed, 0);
+    atomic_store(&round_robin_counter, 0);
+    for (int i = 0; i < printers_num; i++) {
+        struct printer_queue *queue = &printer_queues[i];
+        pthread_mutex_init(&queue->mutex, NULL);
+        pthread_cond_init(&queue->cond, NULL);
+        queue->head = queue->tail = NULL;
+        atomic_init(&queue->length, 0);
+        atomic_init(&queue->work_left_utime, 0);
+        queue->busy_ns = 0;
+        queue->steals = 0;
+    }
+    jobs_start_ns = bench_now_ns();
+    for (int i = 0; i < printers_num; i++) {
+        if (pthread_create(&printer_threads[i], NULL, job_printer_thread, (void *)(intptr_t)i) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < processes_num; i++) {
+        if (pthread_create(&submitter_threads[i], NULL, job_submitter_thread, (void *)(intptr_t)i) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            exit(1);
+        }
+    }
+    for (int i = 0; i < processes_num; i++)
+        pthread_join(submitter_threads[i], NULL);
+    for (int i = 0; i < printers_num; i++)
+        pthread_join(printer_threads[i], NULL);
+
+    uint64_t first_submit = UINT64_MAX, last_complete = 0, busy_ns = 0;
+    result->policy = policy;
+    result->steals = 0;
+    histogram_init(&result->latency);
+    for (int i = 0; i < jobs_total; i++) {
+        if (jobs[i].submit_ns < first_submit)
+            first_submit = jobs[i].submit_ns;
+        if (jobs[i].complete_ns > last_complete)
+            last_complete = jobs[i].complete_ns;
+        histogram_record(&result->latency, jobs[i].complete_ns - jobs[i].submit_ns);
+    }
+    for (int i = 0; i < printers_num; i++) {
+        busy_ns += printer_queues[i].busy_ns;
+        result->steals += printer_queues[i].steals;
+        pthread_cond_destroy(&printer_queues[i].cond);
+        pthread_mutex_destroy(&printer_queues[i].mutex);
+    }
+    result->makespan = (double)(last_complete - first_submit) / 1e9;
+    result->utilization = (double)busy_ns / ((double)(last_complete - first_submit) * printers_num);
+    free(printer_threads);
+    free(submitter_threads);
+    return 0;
+}
+
+void print_jobs_result(struct jobs_result *result) {
+    printf("%-22s %10.3f s %9.1f %% %10.0f %10llu %10llu %10llu %8lu\n",
+           policies_descriptions[result->policy], result->makespan, result->utilization * 100.0,
+           histogram_mean(&result->latency) / 1000.0,
+           (unsigned long long)histogram_percentile(&result->latency, 0.5) / 1000,
+           (unsigned long long)histogram_percentile(&result->latency, 0.99) / 1000,
+           (unsigned long long)result->latency.max / 1000, result->steals);
+}
+
+int run_jobs(int jobs_num, char *policies, int steal) {
+    Policy chosen[POLICIES_NUM];
+    int chosen_num = 0;
+    if (policies == NULL || strcmp(policies, "all") == 0) {
+        for (int i = 0; i < POLICIES_NUM; i++)
+            chosen[chosen_num++] = (Policy)i;
+    }
+    else {
+        char *saveptr;
+        for (char *name = strtok_r(policies, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr)) {
+            int found = 0;
+            for (int i = 0; i < POLICIES_NUM && !found; i++) {
+                if (strcmp(name, policies_names[i]) == 0 && chosen_num < POLICIES_NUM) {
+                    chosen[chosen_num++] = (Policy)i;
+                    found = 1;
+                }
+            }
+            if (!found) {
+                printf("Unknown policy %s. Use random, rr, jsq, p2c, lwl or all.\n", name);
+                return 1;
+            }
+        }
+    }
+
+    jobs_total = jobs_num;
+    jobs_steal = steal;
+    printer_queues = aligned_alloc(CACHE_LINE_SIZE, printers_num * sizeof(struct printer_queue));
+    jobs = malloc(jobs_num * sizeof(struct job));
+    if (printer_queues == NULL || jobs == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    // job sizes and arrivals do not depend on the policy, so every policy prints the same jobs.
+    rng_seed_thread(RNG_MAIN_STREAM);
+    double total_utime = 0;
+    for (int i = 0; i < jobs_num; i++) {
+        if (rng_range(0, 100) < LARGE_JOBS_PERCENT)
+            jobs[i].size_utime = rng_range(LARGE_JOB_MIN_UTIME, LARGE_JOB_MAX_UTIME);
+        else
+            jobs[i].size_utime = rng_range(SMALL_JOB_MIN_UTIME, SMALL_JOB_MAX_UTIME);
+        total_utime += jobs[i].size_utime;
+    }
+    double interval_ns = total_utime * 1000.0 / jobs_num / (JOBS_LOAD * printers_num);
+    // every submitter has exponential gaps between its jobs, so all submitters together keep printers
+    // JOBS_LOAD busy on average.
+    for (int i = 0; i < jobs_num; i++) {
+        double gap = -log(1.0 - rng_uniform()) * interval_ns * processes_num;
+        jobs[i].arrival_ns = (i >= processes_num ? jobs[i - processes_num].arrival_ns : 0) + (uint64_t)gap;
+    }
+
+    struct jobs_result *results = malloc(chosen_num * sizeof(struct jobs_result));
+    if (results == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    printf("Printers jobs: %d printers, %d submitters, %d jobs, load %.0f %%, %s\n", printers_num, processes_num,
+           jobs_num, JOBS_LOAD * 100.0, steal ? "stealing" : "no stealing");
+    for (int i = 0; i < chosen_num; i++)
+        if (run_policy(chosen[i], &results[i]) != 0)
+            return 1;
+    printf("%-22s %12s %11s %10s %10s %10s %10s %8s\n", "policy", "makespan", "utilization", "mean us",
+           "p50 us", "p99 us", "max us", "steals");
+    for (int i = 0; i < chosen_num; i++)
+        print_jobs_result(&results[i]);
+    printf("Operations: %d\n", jobs_num * chosen_num);
+    free(results);
+    free(jobs);
+    free(printer_queues);
+    return 0;
+}
@@ -5,25 +5,85 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include <stdatomic.h>
+#include "../common/bench.h"
+#include "main.h"
 
+#define MAX_ALLOCATORS 8
+
+struct process_stats {
+    unsigned long reservations;
+    unsigned long printers;
+    struct latency_histogram wait;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
 
 int read_args(int argc, char *argv[], int *printers_num, int *processes_num);
+int parse_allocators(char *names);
 void cleanup();
 unsigned int random_utime(unsigned int min, unsigned int max);
 void sigint_handler(int signum);
 int reserve_printer(int id);
 void release_printer(int id, int printer_no);
+int reserve_printers(int id, int k, int *printers_no);
+void release_printers(int id, int k, int *printers_no);
+int random_printers_num();
+int mutex_init();
+int mutex_reserve_printer(int id);
+void mutex_release_printer(int id, int printer_no);
+void mutex_destroy();
 void *process_thread(void *arg);
+void *bench_process_thread(void *arg);
 void thread_cleanup(void *args);
+int get_process_id();
+int run_bench(struct printer_allocator *bench_allocator, sigset_t *old_signal_mask);
+void print_bench_report(struct printer_allocator *bench_allocator, double elapsed);
+void stress_printers_reserved(int id, int k, int *printers_no);
+void stress_printers_released(int k, int *printers_no);
+
+struct printer_allocator mutex_allocator = {
+        "mutex", mutex_init, mutex_reserve_printer, mutex_release_printer, mutex_destroy
+};
+const char *events_formats[] = {
+        "%d is waiting for printer.\n",
+        "%d is using %d printer.\n",
+        "%d released %d printer.\n",
+        "%d is waiting for %d printers.\n",
+        "%d is using printers %d.\n",
+        "%d is using printers %d %d.\n",
+        "%d is using printers %d %d %d.\n",
+        "%d is using printers %d %d %d %d.\n",
+        "%d released %d printers.\n"
+};
+
+struct printer_allocator *all_allocators[] = {&mutex_allocator, &bitmap_allocator, &fifo_allocator,
+                                              &gang_allocator, &sharded_allocator};
+int all_allocators_num = sizeof all_allocators / sizeof all_allocators[0];
+struct printer_allocator *allocators[MAX_ALLOCATORS];
+int allocators_num = 0;
+struct printer_allocator *allocator = NULL;
 
 int printers_num, processes_num;
 int printers_available;
 pthread_mutex_t reserve_printer_mutex;
 pthread_cond_t reserve_printer_cond;
 
+// the key is created only when processes are started, jobs mode and early errors never create it.
 pthread_key_t reservation_locked_key;
+int reservation_locked_key_created = 0;
 pthread_t *threads_ids;
+int threads_started = 0;
 int *printers;
+int verbose = 1;
+
+int jobs_num = 0, jobs_steal_enabled = 1;
+char *jobs_policies = NULL;
+
+double bench_seconds = 0;
+int stress_mode = 0;
+unsigned int bench_hold_utime = 0;
+atomic_int bench_running;
+pthread_barrier_t bench_barrier;
+struct process_stats *processes_stats;
 
 int main(int argc, char *argv[]) {
     atexit(cleanup);
@@ -33,11 +93,28 @@ int main(int argc, char *argv[]) {
     sigaction(SIGINT, &act, NULL);
     sigaction(SIGTSTP, &act, NULL);
 
-    char *args_help = "Enter number of printers and number of processes.\n";
+    char *args_help = "Enter number of printers and number of processes, optionally allocator (mutex, bitmap, fifo, gang\n"
+            "or sharded)\n"
+            "and bench with a number of seconds and holding time in microseconds, or stress with a number of seconds.\n"
+            "In bench and stress modes allocators may be a comma separated list or all.\n"
+            "Alternatively enter jobs, a number of jobs, optionally dispatch policies (random, rr, jsq, p2c, lwl\n"
+            "as a comma separated list or all) and nosteal.\n"
+            "Each mode accepts log with a file for binary event log at the end, seed with a number\n"
+            "and pin with compact, scatter, smt-avoid or a CPU list.\n"
+            "The sharded allocator accepts shards with a number (one per CPU by default).\n";
+    if (rng_init(&argc, argv) != 0 || pin_init(&argc, argv) != 0 || sharded_args(&argc, argv) != 0 ||
+        evlog_init(&argc, argv, events_formats, EVENTS_NUM) != 0)
+        return 1;
     if (read_args(argc, argv, &printers_num, &processes_num) != 0) {
         printf(args_help);
         return 1;
     }
+    if (jobs_num > 0)
+        return run_jobs(jobs_num, jobs_policies, jobs_steal_enabled);
+    if (stress_mode && stress_create(printers_num) != 0)
+        return 1;
+    char *counters_names[] = {"reservations"};
+    metrics_create("printers", "process", processes_num, counters_names, 1, NULL, 0);
 
     threads_ids = malloc(processes_num * sizeof(pthread_t));
     printers = malloc(printers_num * sizeof(int));
@@ -47,20 +124,27 @@ int main(int argc, char *argv[]) {
     }
     for (int i = 0; i < printers_num; i++)
         printers[i] = -1;
-    printers_available = printers_num;
-    pthread_mutex_init(&reserve_printer_mutex, NULL);
-    pthread_cond_init(&reserve_printer_cond, NULL);
-    pthread_key_create(&reservation_locked_key, NULL);
+    reservation_locked_key_created = pthread_key_create(&reservation_locked_key, NULL) == 0;
     // prepare mask for processes' threads (after that, only main thread will catch signals).
     sigset_t signal_mask;
     sigset_t old_signal_mask;
     sigfillset(&signal_mask);
     pthread_sigmask(SIG_SETMASK, &signal_mask, &old_signal_mask);
+    if (bench_seconds > 0) {
+        for (int i = 0; i < allocators_num; i++)
+            if (run_bench(allocators[i], &old_signal_mask) != 0)
+                return 1;
+        return stress != NULL ? stress_report() : 0;
+    }
+    allocator = allocators[0];
+    if (allocator->init() != 0)
+        return 1;
     for (int i = 0; i < processes_num; i++) {
         if (pthread_create(&(threads_ids[i]), NULL, process_thread, NULL) != 0) {
             printf("Error while creating new thread occurred.\n");
             break;
         }
+        threads_started++;
     }
     pthread_sigmask(SIG_SETMASK, &old_signal_mask, NULL);
 
@@ -68,35 +152,82 @@ int main(int argc, char *argv[]) {
         pause();
 }
 
+int get_process_id() {
+    for (int i = 0; i < processes_num; i++) {
+        if (pthread_equal(threads_ids[i], pthread_self()))
+            return i;
+    }
+    return 0;
+}
+
 void *process_thread(void *arg) {
     pthread_cleanup_push(thread_cleanup, NULL);
-            int process_id = 0;
-            for (int i = 0; i < processes_num; i++) {
-                if (pthread_equal(threads_ids[i], pthread_self())) {
-                    process_id = i;
-                    break;
-                }
-            }
+            int process_id = get_process_id();
+            rng_seed_thread(process_id);
+            pin_thread("Process", process_id, process_id);
             int * reservation_locked = malloc(sizeof(int));
             *reservation_locked = 0;
             pthread_setspecific(reservation_locked_key, reservation_locked);
             unsigned int min_time = 500000, max_time = 1000000;
-            int printer_no;
+            int printers_no[GANG_MAX_PRINTERS];
+            int k;
             while (1) {
                 usleep(random_utime(min_time, max_time));
-                printer_no = reserve_printer(process_id);
+                k = random_printers_num();
+                reserve_printers(process_id, k, printers_no);
+                metrics_count(process_id, 0);
                 usleep(random_utime(min_time, max_time));
-                release_printer(process_id, printer_no);
+                release_printers(process_id, k, printers_no);
             }
     pthread_cleanup_pop(1);
     return NULL;
 }
 
 int reserve_printer(int id) {
+    return allocator->reserve(id);
+}
+
+void release_printer(int id, int printer_no) {
+    allocator->release(id, printer_no);
+}
+
+// all k printers are reserved at once, or the call waits; allocators without gang support accept only k = 1.
+int reserve_printers(int id, int k, int *printers_no) {
+    if (allocator->reserve_many != NULL)
+        return allocator->reserve_many(id, k, printers_no);
+    if (k != 1)
+        return -1;
+    printers_no[0] = reserve_printer(id);
+    return 0;
+}
+
+void release_printers(int id, int k, int *printers_no) {
+    if (allocator->release_many != NULL)
+        allocator->release_many(id, k, printers_no);
+    else
+        release_printer(id, printers_no[0]);
+}
+
+int random_printers_num() {
+    if (allocator->reserve_many == NULL)
+        return 1;
+    int max = printers_num < GANG_MAX_PRINTERS ? printers_num : GANG_MAX_PRINTERS;
+    return (int)rng_range(1, max + 1);
+}
+
+int mutex_init() {
+    printers_available = printers_num;
+    pthread_mutex_init(&reserve_printer_mutex, NULL);
+    pthread_cond_init(&reserve_printer_cond, NULL);
+    return 0;
+}
+
+int mutex_reserve_printer(int id) {
     int *reservation_locked = pthread_getspecific(reservation_locked_key);
     pthread_mutex_lock(&reserve_printer_mutex);
     *reservation_locked = 1;
-    printf("%d is waiting for printer.\n", id);
+    if (verbose)
+        evlog(EVENT_WAITING_FOR_PRINTER, id, 0, 0, 0, 0);
     while (printers_available == 0) {
         pthread_cond_wait(&reserve_printer_cond, &reserve_printer_mutex);
     }
@@ -109,31 +240,179 @@ int reserve_printer(int id) {
     }
     printers[printer_no] = id;
     printers_available--;
-    printf("%d is using %d printer.\n", id, printer_no);
+    if (verbose)
+        evlog(EVENT_USING_PRINTER, id, printer_no, 0, 0, 0);
     pthread_mutex_unlock(&reserve_printer_mutex);
     *reservation_locked = 0;
     return printer_no;
 }
 
-void release_printer(int id, int printer_id) {
+void mutex_release_printer(int id, int printer_id) {
     int *reservation_locked = pthread_getspecific(reservation_locked_key);
     pthread_mutex_lock(&reserve_printer_mutex);
     *reservation_locked = 1;
     printers[printer_id] = -1;
     printers_available++;
-    printf("%d released %d printer.\n", id, printer_id);
-    fflush(stdout);
+    if (verbose)
+        evlog(EVENT_RELEASED_PRINTER, id, printer_id, 0, 0, 0);
     pthread_cond_signal(&reserve_printer_cond);
     pthread_mutex_unlock(&reserve_printer_mutex);
     *reservation_locked = 0;
 }
 
+void mutex_destroy() {
+    pthread_cond_destroy(&reserve_printer_cond);
+    pthread_mutex_destroy(&reserve_printer_mutex);
+}
+
+// processes reserve printers in a loop without sleeps, holding each printer for bench_hold_utime.
+void *bench_process_thread(void *arg) {
+    int reservation_locked = 0;
+    pthread_setspecific(reservation_locked_key, &reservation_locked);
+    int process_id = get_process_id();
+    rng_seed_thread(process_id);
+    pin_thread("Process", process_id, process_id);
+    pthread_barrier_wait(&bench_barrier);
+    struct process_stats *stats = &processes_stats[process_id];
+    uint64_t wait_start;
+    int printers_no[GANG_MAX_PRINTERS];
+    int k;
+    while (atomic_load_explicit(&bench_running, memory_order_relaxed)) {
+        k = random_printers_num();
+        wait_start = bench_now_ns();
+        reserve_printers(process_id, k, printers_no);
+        histogram_record(&stats->wait, bench_now_ns() - wait_start);
+        stats->reservations++;
+        metrics_count(process_id, 0);
+        stats->printers += k;
+        if (stress != NULL)
+            stress_printers_reserved(process_id, k, printers_no);
+        if (bench_hold_utime > 0)
+            usleep(bench_hold_utime);
+        if (stress != NULL)
+            stress_printers_released(k, printers_no);
+        release_printers(process_id, k, printers_no);
+    }
+    return NULL;
+}
+
+// shadow i counts the processes holding printer i, a process counts itself only between getting and giving back
+// the printer, so anything above 1 means the allocator gave the printer to two processes.
+void stress_printers_reserved(int id, int k, int *printers_no) {
+    for (int i = 0; i < k; i++) {
+        if (printers_no[i] < 0 || printers_no[i] >= printers_num) {
+            stress_violation("%d got printer %d of %d.", id, printers_no[i], printers_num);
+            continue;
+        }
+        long long holders = stress_add(printers_no[i], 1);
+        if (holders != 1)
+            stress_violation("%d is using printer %d held by %lld processes.", id, printers_no[i], holders);
+    }
+}
+
+void stress_printers_released(int k, int *printers_no) {
+    for (int i = 0; i < k; i++)
+        if (printers_no[i] >= 0 && printers_no[i] < printers_num)
+            stress_add(printers_no[i], -1);
+}
+
+int run_bench(struct printer_allocator *bench_allocator, sigset_t *old_signal_mask) {
+    allocator = bench_allocator;
+    verbose = 0;
+    for (int i = 0; i < printers_num; i++)
+        printers[i] = -1;
+    if (allocator->init() != 0)
+        return 1;
+    processes_stats = aligned_alloc(CACHE_LINE_SIZE, processes_num * sizeof(struct process_stats));
+    if (processes_stats == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < processes_num; i++) {
+        processes_stats[i].reservations = 0;
+        processes_stats[i].printers = 0;
+        histogram_init(&processes_stats[i].wait);
+    }
+    atomic_store(&bench_running, 1);
+    pthread_barrier_init(&bench_barrier, NULL, processes_num + 1);
+    for (int i = 0; i < processes_num; i++) {
+        if (pthread_create(&(threads_ids[i]), NULL, bench_process_thread, NULL) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            exit(1);
+        }
+    }
+    pthread_sigmask(SIG_SETMASK, old_signal_mask, NULL);
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t start = bench_now_ns();
+    bench_sleep(bench_seconds);
+    atomic_store(&bench_running, 0);
+    for (int i = 0; i < processes_num; i++)
+        pthread_join(threads_ids[i], NULL);
+    double elapsed = (double)(bench_now_ns() - start) / 1e9;
+    pthread_barrier_destroy(&bench_barrier);
+    allocator->destroy();
+    allocator = NULL;
+    print_bench_report(bench_allocator, elapsed);
+    free(processes_stats);
+    return 0;
+}
+
+void print_bench_report(struct printer_allocator *bench_allocator, double elapsed) {
+    struct latency_histogram wait;
+    unsigned long total_reservations = 0, total_printers = 0;
+    double *reservations = malloc(processes_num * sizeof(double));
+    histogram_init(&wait);
+    for (int i = 0; i < processes_num; i++) {
+        total_reservations += processes_stats[i].reservations;
+        total_printers += processes_stats[i].printers;
+        histogram_merge(&wait, &processes_stats[i].wait);
+        if (reservations != NULL)
+            reservations[i] = (double)processes_stats[i].reservations;
+    }
+    printf("Printers %s (%s): %d printers, %d processes, %.2f s\n", stress_mode ? "stress test" : "benchmark",
+           bench_allocator->name, printers_num, processes_num, elapsed);
+    printf("Operations: %lu\n", total_reservations);
+    printf("Throughput: %.1f reservations/s\n", (double)total_reservations / elapsed);
+    printf("Printers reserved: %lu (%.2f per reservation)\n", total_printers,
+           total_reservations == 0 ? 0.0 : (double)total_printers / (double)total_reservations);
+    printf("Wait: mean %.0f ns, p50 %llu ns, p99 %llu ns, p99.9 %llu ns, max %llu ns\n", histogram_mean(&wait),
+           (unsigned long long)histogram_percentile(&wait, 0.5), (unsigned long long)histogram_percentile(&wait, 0.99),
+           (unsigned long long)histogram_percentile(&wait, 0.999), (unsigned long long)wait.max);
+    if (reservations != NULL)
+        printf("Jain fairness index: %.4f\n", jain_index(reservations, processes_num));
+    free(reservations);
+}
+
 unsigned int random_utime(unsigned int min, unsigned int max) {
-    return ((unsigned)rand() % (max - min)) + min;
+    return rng_range(min, max);
+}
+
+int parse_allocators(char *names) {
+    if (strcmp(names, "all") == 0) {
+        for (int i = 0; i < all_allocators_num; i++)
+            allocators[i] = all_allocators[i];
+        allocators_num = all_allocators_num;
+        return 0;
+    }
+    char *saveptr;
+    for (char *name = strtok_r(names, ",", &saveptr); name != NULL; name = strtok_r(NULL, ",", &saveptr)) {
+        int found = 0;
+        for (int i = 0; i < all_allocators_num && !found; i++) {
+            if (strcmp(name, all_allocators[i]->name) == 0 && allocators_num < MAX_ALLOCATORS) {
+                allocators[allocators_num++] = all_allocators[i];
+                found = 1;
+            }
+        }
+        if (!found) {
+            printf("Unknown allocator %s.\n", name);
+            return 1;
+        }
+    }
+    return 0;
 }
 
 int read_args(int argc, char *argv[], int *printers_num, int *processes_num) {
-    if (argc != 3) {
+    if (argc < 3 || argc > 7) {
         printf("Incorrect number of arguments.\n");
         return 1;
     }
@@ -148,6 +427,53 @@ int read_args(int argc, char *argv[], int *printers_num, int *processes_num) {
         printf("Incorrect number of processes. It should be > 0.\n");
         return 1;
     }
+    if (arg_num < argc && strcmp(argv[arg_num], "jobs") == 0) {
+        arg_num++;
+        if (arg_num == argc || (jobs_num = atoi(argv[arg_num++])) < 1) {
+            printf("Incorrect number of jobs. It should be > 0.\n");
+            return 1;
+        }
+        if (arg_num < argc && strcmp(argv[arg_num], "nosteal") != 0)
+            jobs_policies = argv[arg_num++];
+        if (arg_num < argc && strcmp(argv[arg_num], "nosteal") == 0) {
+            jobs_steal_enabled = 0;
+            arg_num++;
+        }
+        if (arg_num != argc) {
+            printf("Incorrect number of arguments.\n");
+            return 1;
+        }
+        return 0;
+    }
+    if (arg_num < argc && strcmp(argv[arg_num], "bench") != 0 && strcmp(argv[arg_num], "stress") != 0) {
+        if (parse_allocators(argv[arg_num++]) != 0)
+            return 1;
+    }
+    else {
+        allocators[allocators_num++] = &mutex_allocator;
+    }
+    if (arg_num < argc) {
+        stress_mode = strcmp(argv[arg_num], "stress") == 0;
+        if ((strcmp(argv[arg_num++], "bench") != 0 && !stress_mode) || arg_num == argc) {
+            printf("Incorrect arguments.\n");
+            return 1;
+        }
+        bench_seconds = atof(argv[arg_num++]);
+        if (bench_seconds <= 0) {
+            printf("Incorrect number of seconds. It should be > 0.\n");
+            return 1;
+        }
+        if (arg_num < argc && !stress_mode)
+            bench_hold_utime = (unsigned)atoi(argv[arg_num++]);
+    }
+    if (arg_num != argc) {
+        printf("Incorrect number of arguments.\n");
+        return 1;
+    }
+    if (bench_seconds == 0 && allocators_num != 1) {
+        printf("Only one allocator can be used outside of bench mode.\n");
+        return 1;
+    }
 
     return 0;
 }
@@ -159,14 +485,19 @@ void thread_cleanup(void *args) {
 }
 
 void cleanup() {
-    for (int i = 0; i < processes_num; i++)
+    for (int i = 0; i < threads_started; i++)
         pthread_cancel(threads_ids[i]);
-    for (int i = 0; i < processes_num; i++)
+    for (int i = 0; i < threads_started; i++)
         pthread_join(threads_ids[i], NULL);
-    pthread_cond_destroy(&reserve_printer_cond);
-    pthread_mutex_destroy(&reserve_printer_mutex);
-    pthread_key_delete(reservation_locked_key);
+    if (allocator != NULL)
+        allocator->destroy();
+    if (reservation_locked_key_created)
+        pthread_key_delete(reservation_locked_key);
     free(threads_ids);
+    free(printers);
+    evlog_close();
+    metrics_destroy();
+    stress_destroy();
 }
 
 void sigint_handler(int signum) {
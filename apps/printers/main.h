@@ -0,0 +1,60 @@
+#ifndef PRINTERS_MAIN_H
+#define PRINTERS_MAIN_H
+
+#include "../common/evlog.h"
+#include "../common/rng.h"
+#include "../common/pin.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
+#include "../common/lockprof.h"
+
+#define GANG_MAX_PRINTERS 4
+
+// EVENT_USING_PRINTERS + k - 1 is logged when k printers are reserved at once.
+enum printers_event {
+    EVENT_WAITING_FOR_PRINTER,
+    EVENT_USING_PRINTER,
+    EVENT_RELEASED_PRINTER,
+    EVENT_WAITING_FOR_PRINTERS,
+    EVENT_USING_PRINTERS,
+    EVENT_USING_PRINTERS_2,
+    EVENT_USING_PRINTERS_3,
+    EVENT_USING_PRINTERS_4,
+    EVENT_RELEASED_PRINTERS,
+    EVENTS_NUM
+};
+
+// reserve_many and release_many are set only by allocators able to reserve k printers at once.
+struct printer_allocator {
+    char *name;
+    int (*init)();
+    int (*reserve)(int id);
+    void (*release)(int id, int printer_no);
+    void (*destroy)();
+    int (*reserve_many)(int id, int k, int *printers_no);
+    void (*release_many)(int id, int k, int *printers_no);
+};
+
+extern int printers_num, processes_num;
+extern int *printers;
+extern int verbose;
+
+extern int bitmap_words;
+
+int bitmap_init();
+int bitmap_claim_printer(int start_word);
+void bitmap_put_printer(int printer_no);
+void bitmap_destroy();
+
+int run_jobs(int jobs_num, char *policies, int steal);
+int sharded_args(int *argc, char *argv[]);
+int gang_reserve_printers(int id, int k, int *printers_no);
+void gang_release_printers(int id, int k, int *printers_no);
+
+extern struct printer_allocator mutex_allocator;
+extern struct printer_allocator bitmap_allocator;
+extern struct printer_allocator fifo_allocator;
+extern struct printer_allocator gang_allocator;
+extern struct printer_allocator sharded_allocator;
+
+#endif //PRINTERS_MAIN_H
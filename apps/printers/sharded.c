@@ -0,0 +1,197 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "../common/bench.h"
+#include "main.h"
+
+int sharded_init();
+int sharded_reserve_printer(int id);
+void sharded_release_printer(int id, int printer_no);
+void sharded_destroy();
+
+struct printer_allocator sharded_allocator = {
+        "sharded", sharded_init, sharded_reserve_printer, sharded_release_printer, sharded_destroy
+};
+
+// printer i belongs to shard i % shards_num and always returns there. A process takes printers from the shard of
+// the CPU it runs on and steals from other shards only when that one is empty. When every shard is empty it sleeps
+// on its local shard until a printer is freed there or it gets a wakeup token. A release into a shard without
+// waiters gives a token to a shard that has them. A woken waiter may take a printer other than the one it was
+// woken for, so after it gets one it passes a token on while printers are still free and others wait.
+// No waiter sleeps while a printer is free: it registers before it looks at the shards, and a release after its
+// look sees it and gives it a token under the mutex of its shard.
+struct printer_shard {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int *free_stack;
+    atomic_int free_num;
+    atomic_int waiting;
+    int wakeups;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct printer_shard *shards;
+int shards_num, cpus_num, forced_shards_num = 0;
+atomic_int sharded_waiters __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// removes "shards <n>" from the arguments, it overrides the number of shards (one per CPU by default).
+int sharded_args(int *argc, char *argv[]) {
+    for (int i = 1; i + 1 < *argc; i++) {
+        if (strcmp(argv[i], "shards") == 0) {
+            forced_shards_num = atoi(argv[i + 1]);
+            if (forced_shards_num < 1) {
+                printf("Incorrect number of shards. It should be > 0.\n");
+                return 1;
+            }
+            memmove(&argv[i], &argv[i + 2], (*argc - i - 1) * sizeof(char *));
+            *argc -= 2;
+            break;
+        }
+    }
+    return 0;
+}
+
+int sharded_init() {
+    cpus_num = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus_num < 1)
+        cpus_num = 1;
+    shards_num = forced_shards_num > 0 ? forced_shards_num : cpus_num;
+    if (shards_num > printers_num)
+        shards_num = printers_num;
+    shards = aligned_alloc(CACHE_LINE_SIZE, shards_num * sizeof(struct printer_shard));
+    if (shards == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < shards_num; i++) {
+        struct printer_shard *shard = &shards[i];
+        shard->free_stack = malloc((printers_num / shards_num + 1) * sizeof(int));
+        if (shard->free_stack == NULL) {
+            printf("Error while allocating memory occurred.\n");
+            return 1;
+        }
+        pthread_mutex_init(&shard->mutex, NULL);
+        pthread_cond_init(&shard->cond, NULL);
+        atomic_init(&shard->free_num, 0);
+        atomic_init(&shard->waiting, 0);
+        shard->wakeups = 0;
+    }
+    for (int i = printers_num - 1; i >= 0; i--) {
+        struct printer_shard *shard = &shards[i % shards_num];
+        shard->free_stack[atomic_fetch_add(&shard->free_num, 1)] = i;
+    }
+    atomic_init(&sharded_waiters, 0);
+    if (verbose)
+        printf("Printers are split into %d shards.\n", shards_num);
+    return 0;
+}
+
+// with more shards than CPUs, which only happens when they are forced, processes are spread over them by id.
+int local_shard(int id) {
+    int cpu = sched_getcpu();
+    return (cpu < 0 || shards_num > cpus_num ? id : cpu) % shards_num;
+}
+
+int take_from_shard(struct printer_shard *shard) {
+    int printer_no = -1;
+    // not relaxed: a waiter must see a printer freed before the release looked for waiters.
+    if (atomic_load(&shard->free_num) == 0)
+        return -1;
+    pthread_mutex_lock(&shard->mutex);
+    int free_num = atomic_load_explicit(&shard->free_num, memory_order_relaxed);
+    if (free_num > 0) {
+        printer_no = shard->free_stack[free_num - 1];
+        atomic_store(&shard->free_num, free_num - 1);
+    }
+    pthread_mutex_unlock(&shard->mutex);
+    return printer_no;
+}
+
+int take_from_any_shard(int local) {
+    int printer_no;
+    for (int i = 0; i < shards_num; i++)
+        if ((printer_no = take_from_shard(&shards[(local + i) % shards_num])) >= 0)
+            return printer_no;
+    return -1;
+}
+
+// gives a wakeup token to the first shard from first on which processes wait.
+void pass_wakeup(int first) {
+    for (int i = 0; i < shards_num; i++) {
+        struct printer_shard *shard = &shards[(first + i) % shards_num];
+        if (atomic_load(&shard->waiting) > 0) {
+            pthread_mutex_lock(&shard->mutex);
+            shard->wakeups++;
+            pthread_cond_signal(&shard->cond);
+            pthread_mutex_unlock(&shard->mutex);
+            return;
+        }
+    }
+}
+
+int any_free_printer() {
+    for (int i = 0; i < shards_num; i++)
+        if (atomic_load(&shards[i].free_num) > 0)
+            return 1;
+    return 0;
+}
+
+int sharded_reserve_printer(int id) {
+    int local = local_shard(id);
+    struct printer_shard *shard = &shards[local];
+    if (verbose)
+        evlog(EVENT_WAITING_FOR_PRINTER, id, 0, 0, 0, 0);
+    int printer_no = take_from_any_shard(local);
+    if (printer_no < 0) {
+        atomic_fetch_add(&sharded_waiters, 1);
+        atomic_fetch_add(&shard->waiting, 1);
+        while ((printer_no = take_from_any_shard(local)) < 0) {
+            pthread_mutex_lock(&shard->mutex);
+            pthread_cleanup_push((void (*)(void *))pthread_mutex_unlock, &shard->mutex);
+            while (atomic_load(&shard->free_num) == 0 && shard->wakeups == 0)
+                pthread_cond_wait(&shard->cond, &shard->mutex);
+            // a token is used up only when it was the reason to wake, a printer of the shard does not need one.
+            if (atomic_load(&shard->free_num) == 0)
+                shard->wakeups--;
+            pthread_cleanup_pop(1);
+        }
+        atomic_fetch_sub(&shard->waiting, 1);
+        if (atomic_fetch_sub(&sharded_waiters, 1) > 1 && any_free_printer())
+            pass_wakeup(local);
+    }
+    printers[printer_no] = id;
+    if (verbose)
+        evlog(EVENT_USING_PRINTER, id, printer_no, 0, 0, 0);
+    return printer_no;
+}
+
+void sharded_release_printer(int id, int printer_no) {
+    int home = printer_no % shards_num;
+    struct printer_shard *shard = &shards[home];
+    printers[printer_no] = -1;
+    pthread_mutex_lock(&shard->mutex);
+    int free_num = atomic_load_explicit(&shard->free_num, memory_order_relaxed);
+    shard->free_stack[free_num] = printer_no;
+    atomic_store(&shard->free_num, free_num + 1);
+    int has_waiters = atomic_load(&shard->waiting) > 0;
+    if (has_waiters)
+        pthread_cond_signal(&shard->cond);
+    pthread_mutex_unlock(&shard->mutex);
+    if (!has_waiters && atomic_load(&sharded_waiters) > 0)
+        pass_wakeup(home);
+    if (verbose)
+        evlog(EVENT_RELEASED_PRINTER, id, printer_no, 0, 0, 0);
+}
+
+void sharded_destroy() {
+    for (int i = 0; i < shards_num; i++) {
+        pthread_cond_destroy(&shards[i].cond);
+        pthread_mutex_destroy(&shards[i].mutex);
+        free(shards[i].free_stack);
+    }
+    free(shards);
+}
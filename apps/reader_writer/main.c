@@ -10,12 +10,18 @@
 #include <time.h>
 #include <semaphore.h>
 #include <sys/wait.h>
+#include "../common/rng.h"
+#include "../common/pin.h"
+#include "../common/spawner.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
 #include "main.h"
 
 void sigint_handler(int signum);
 void cleanup();
 char *get_app_path(char *app_name, char *main_path);
 int read_args(int argc, char *argv[], int *readers_num, int *writers_num);
+int run_stress(double seconds);
 
 sem_t * sem_id_w;
 sem_t * sem_id_r;
@@ -24,10 +30,15 @@ struct shm_mem * shm = (struct shm_mem *)-1;
 int writers_num, readers_num;
 pid_t *writers;
 pid_t *readers;
+int spawn_mode = SPAWN_POSIX;
+double stress_seconds = 0;
 
 int main(int argc, char *argv[]) {
-    char *args_help = "Enter number of readers and number of writers.\n";
-    if (read_args(argc, argv, &readers_num, &writers_num) != 0) {
+    char *args_help = "Enter number of readers and number of writers,\n"
+            "optionally spawn with fork, posix or pool, stress with a number of seconds, seed with a number\n"
+            "and pin with compact, scatter, smt-avoid or a CPU list.\n";
+    if (rng_init(&argc, argv) != 0 || pin_init(&argc, argv) != 0 ||
+        read_args(argc, argv, &readers_num, &writers_num) != 0) {
         printf(args_help);
         return 1;
     }
@@ -42,6 +53,11 @@ int main(int argc, char *argv[]) {
     sigaction(SIGINT, &act, NULL);
     sigaction(SIGTSTP, &act, NULL);
 
+    if (stress_seconds > 0 && stress_create(2) != 0)
+        return 1;
+    char *counters_names[] = {"reads", "writes"};
+    metrics_create("rw", "process", writers_num + readers_num, counters_names, 2, NULL, 0);
+
     shm_id = shm_open(SHM_NAME, O_CREAT | O_RDWR, S_IWUSR | S_IRUSR);
     if (shm_id < 0 || ftruncate(shm_id, MEM_SIZE) < 0 ||
             (shm = (struct shm_mem *)mmap(0, MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_id, 0)) < 0) {
@@ -65,42 +81,72 @@ int main(int argc, char *argv[]) {
     readers = malloc(readers_num * sizeof(pid_t));
     for (int i = 0; i < readers_num; i++)
         readers[i] = 0;
+    if (spawner_init(spawn_mode, writers_num + readers_num, &full_mask) != 0)
+        return 1;
     char * writer_exe = get_app_path("rw_writer", argv[0]);
     char * reader_exe = get_app_path("rw_reader", argv[0]);
     for (int i = 0; i < writers_num; i++) {
-        pid_t pid = fork();
+        pid_t pid = spawner_start(writer_exe);
         if (pid < 0)
             printf("Error while creating new process occurred.\n");
-        else if (pid == 0) {
-            sigprocmask(SIG_SETMASK, &full_mask, NULL);
-            execl(writer_exe, writer_exe, NULL);
-        }
-        else
+        else {
             writers[i] = pid;
+            pin_process(pid, "Writer", i, i);
+        }
     }
     for (int i = 0; i < readers_num; i++) {
-        pid_t pid = fork();
+        pid_t pid = spawner_start(reader_exe);
         if (pid < 0)
             printf("Error while creating new process occurred.\n");
-        else if (pid == 0) {
-            sigprocmask(SIG_SETMASK, &full_mask, NULL);
-            execl(reader_exe, reader_exe, NULL);
-        }
-        else
+        else {
             readers[i] = pid;
+            pin_process(pid, "Reader", i, writers_num + i);
+        }
     }
+    int ready_num;
+    double ready_time = spawner_release(&ready_num);
+    printf("%d of %d processes ready after %.3f ms (%s spawn).\n", ready_num, writers_num + readers_num,
+           ready_time * 1e3, spawn_modes_names[spawn_mode]);
+    fflush(stdout);
     free(writer_exe);
     free(reader_exe);
+    if (stress_seconds > 0)
+        return run_stress(stress_seconds);
 
     while (1)
         pause();
 }
 
+// readers and writers run without sleeps and printing (they see the stress segment), the report is printed while
+// they are still running, so killing them cannot disturb the shadows before that.
+int run_stress(double seconds) {
+    uint64_t start = bench_now_ns();
+    bench_sleep(seconds);
+    double elapsed = (double)(bench_now_ns() - start) / 1e9;
+    uint64_t reads = metrics_total(0), writes = metrics_total(1);
+    printf("Reader-writer stress test: %d readers, %d writers, %.2f s\n", readers_num, writers_num, elapsed);
+    printf("Operations: %llu\n", (unsigned long long)(reads + writes));
+    printf("Throughput: %.1f operations/s\n", (double)(reads + writes) / elapsed);
+    printf("Reads: %llu, writes: %llu\n", (unsigned long long)reads, (unsigned long long)writes);
+    return stress_report();
+}
+
 int read_args(int argc, char *argv[], int *readers_num, int *writers_num) {
-    if (argc != 3) {
+    if (argc >= 5 && strcmp(argv[argc - 2], "stress") == 0) {
+        if ((stress_seconds = atof(argv[argc - 1])) <= 0) {
+            printf("Incorrect number of seconds. It should be > 0.\n");
+            return 1;
+        }
+        argc -= 2;
+    }
+    if (argc != 3 && !(argc == 5 && strcmp(argv[3], "spawn") == 0)) {
         printf("Incorrect number of arguments.\n");
         return 1;
     }
+    if (argc == 5 && (spawn_mode = spawn_parse_mode(argv[4])) < 0) {
+        printf("Incorrect spawn mode. It should be fork, posix or pool.\n");
+        return 1;
+    }
     int arg_num = 1;
     *readers_num = atoi(argv[arg_num++]);
     if (*readers_num < 1) {
@@ -152,6 +198,9 @@ void cleanup() {
 
     free(writers);
     free(readers);
+    spawner_destroy();
+    metrics_destroy();
+    stress_destroy();
     if (sem_id_w >= 0) {
         sem_close(sem_id_w);
         sem_unlink(SEM_NAME_W);
@@ -7,6 +7,9 @@
 #define ARRAY_LEN 500
 #define MEM_SIZE (ARRAY_LEN) * sizeof(int)
 #define MAX_READERS 50
+// stress shadows: readers reading and writers writing.
+#define SHADOW_READING 0
+#define SHADOW_WRITING 1
 
 struct shm_mem {
     int numbers[ARRAY_LEN];
@@ -11,6 +11,9 @@
 #include <string.h>
 #include <sys/time.h>
 #include <string.h>
+#include "../common/spawner.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
 #include "main.h"
 
 void sigint_handler(int signum);
@@ -43,21 +46,37 @@ int main(int argc, char *argv[]) {
         printf("Error while opening semaphores occurred.\n");
         return 1;
     }
+    metrics_attach();
+    stress_attach();
+    int metrics_id = spawn_child_index();
+    spawn_barrier_wait();
 
     while (1) {
         if (sem_wait(sem_id_r) < 0) {
             printf("Error while waiting for semaphore occurred.\n");
             return 1;
         }
-        printf("%d is reading.\n", getpid());
-        fflush(stdout);
-        printf("%d has stopped reading.\n", getpid());
-        fflush(stdout);
+        if (stress != NULL) {
+            // counted as reading before looking at the writers, a writer does it the other way round.
+            stress_add(SHADOW_READING, 1);
+            long long writing = stress_load(SHADOW_WRITING);
+            if (writing != 0)
+                stress_violation("%d is reading while %lld writers are writing.", getpid(), writing);
+            stress_add(SHADOW_READING, -1);
+        }
+        else {
+            printf("%d is reading.\n", getpid());
+            fflush(stdout);
+            printf("%d has stopped reading.\n", getpid());
+            fflush(stdout);
+        }
+        metrics_count(metrics_id, 0);
         if (sem_post(sem_id_r) < 0) {
             printf("Error while incrementing semaphore occurred.\n");
             return 1;
         }
-        nanosleep(&delay, NULL); // some important calculations here
+        if (stress == NULL)
+            nanosleep(&delay, NULL); // some important calculations here
     }
 }
 
@@ -71,6 +90,8 @@ void cleanup() {
         }
         close(shm_id);
     }
+    metrics_destroy();
+    stress_destroy();
 }
 
 void sigint_handler(int signum) {
@@ -10,6 +10,10 @@
 #include <time.h>
 #include <semaphore.h>
 #include <sys/time.h>
+#include "../common/rng.h"
+#include "../common/spawner.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
 #include "main.h"
 
 void sigint_handler(int signum);
@@ -32,7 +36,8 @@ int main(int argc, char *argv[]) {
     act.sa_handler = sigint_handler;
     sigaction(SIGUSR1, &act, NULL);
 
-    srand(time(NULL));
+    if (rng_init(&argc, argv) != 0)
+        return 1;
 
     shm_id = shm_open(SHM_NAME, O_RDWR, 0);
     if (shm_id < 0 || (shm = (struct shm_mem *)mmap(0, MEM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, shm_id, 0)) < 0) {
@@ -46,6 +51,10 @@ int main(int argc, char *argv[]) {
         printf("Error while opening semaphores occurred.\n");
         return 1;
     }
+    metrics_attach();
+    stress_attach();
+    int metrics_id = spawn_child_index();
+    spawn_barrier_wait();
 
     int index;
     while (1) {
@@ -61,13 +70,28 @@ int main(int argc, char *argv[]) {
                 return 1;
             }
         }
-        printf("%d is writing.\n", getpid());
-        fflush(stdout);
-        index = rand() % ARRAY_LEN;
-        shm->numbers[index] = rand();
+        if (stress != NULL) {
+            long long writing = stress_add(SHADOW_WRITING, 1);
+            long long reading = stress_load(SHADOW_READING);
+            if (writing != 1 || reading != 0)
+                stress_violation("%d is writing together with %lld writers and %lld readers.", getpid(),
+                                 writing - 1, reading);
+        }
+        else {
+            printf("%d is writing.\n", getpid());
+            fflush(stdout);
+        }
+        index = (int)rng_range(0, ARRAY_LEN);
+        shm->numbers[index] = (int)(rng_next() >> 33);
         //nanosleep(&delay, NULL);
-        printf("%d has stopped writing.\n", getpid());
-        fflush(stdout);
+        if (stress != NULL) {
+            stress_add(SHADOW_WRITING, -1);
+        }
+        else {
+            printf("%d has stopped writing.\n", getpid());
+            fflush(stdout);
+        }
+        metrics_count(metrics_id, 1);
         for (int i = 0; i < MAX_READERS; i++) {
             if (sem_post(sem_id_r) < 0) {
                 printf("Error while incrementing semaphore occurred.\n");
@@ -79,7 +103,8 @@ int main(int argc, char *argv[]) {
             printf("Error while incrementing semaphore occurred.\n");
             return 1;
         }
-        nanosleep(&delay, NULL); // some important calculations here
+        if (stress == NULL)
+            nanosleep(&delay, NULL); // some important calculations here
     }
 }
 
@@ -96,6 +121,8 @@ void cleanup() {
         }
         close(shm_id);
     }
+    metrics_destroy();
+    stress_destroy();
 }
 
 void sigint_handler(int signum) {
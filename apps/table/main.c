@@ -5,19 +5,44 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
+#include "main.h"
 
 
 int read_args(int argc, char *argv[], int *pairs_num);
 void cleanup();
 unsigned int random_utime(unsigned int min, unsigned int max);
 void sigint_handler(int signum);
-void get_table(int id);
-void release_table(int id);
+int get_table(int id);
+void release_table(int id, int table);
+int single_seat_pair(int id);
+void single_release_table(int id, int table);
 void *person_thread(void *arg);
 void thread_cleanup(void *args);
+int get_person_id();
+int run_bench(sigset_t *old_signal_mask);
+void print_bench_report(double elapsed);
+void stress_table_taken(int id, int table);
+void stress_table_left(int id, int table);
+
+struct table_mode single_mode = {
+        "single", NULL, single_seat_pair, single_release_table, NULL
+};
+struct table_mode *mode = &single_mode;
+
+const char *events_formats[] = {
+        "%d is waiting for the second person.\n",
+        "Pair %d and %d is complete. Waiting for table.\n",
+        "Pair %d and %d got a table.\n",
+        "Pair %d and %d got table %d.\n",
+        "%d released the table.\n",
+        "%d released table %d.\n"
+};
 
 int pairs_num, using_table = 0;
+int tables_num = 1;
+int rendezvous = 0;
 int *waiting_for_pair;
+int *pair_tables;
 pthread_mutex_t *waiting_for_pair_mutex;
 pthread_cond_t *waiting_for_pair_cond;
 pthread_mutex_t waiting_for_table_mutex;
@@ -26,6 +51,13 @@ pthread_cond_t waiting_for_table_cond;
 pthread_key_t table_locked_key;
 pthread_key_t pair_locked_key;
 pthread_t *threads_ids;
+int threads_started = 0;
+int verbose = 1;
+
+double bench_seconds = 0;
+int stress_mode = 0;
+pthread_barrier_t bench_barrier;
+struct person_stats *persons_stats;
 
 int main(int argc, char *argv[]) {
     atexit(cleanup);
@@ -35,17 +67,29 @@ int main(int argc, char *argv[]) {
     sigaction(SIGINT, &act, NULL);
     sigaction(SIGTSTP, &act, NULL);
 
-    char *args_help = "Enter number of pairs.\n";
+    char *args_help = "Enter number of pairs, optionally tables with a number of tables, rendezvous,\n"
+            "bench or stress with a number of seconds and log with a file for binary event log.\n"
+            "Every mode accepts seed with a number and pin with compact, scatter, smt-avoid or a CPU list.\n";
+    if (rng_init(&argc, argv) != 0 || pin_init(&argc, argv) != 0 ||
+        evlog_init(&argc, argv, events_formats, EVENTS_NUM) != 0)
+        return 1;
     if (read_args(argc, argv, &pairs_num) != 0) {
         printf(args_help);
         return 1;
     }
+    if (stress_mode && stress_create(tables_num) != 0)
+        return 1;
+    char *counters_names[] = {"seatings"};
+    metrics_create("table", "person", pairs_num * 2, counters_names, 1, NULL, 0);
 
     threads_ids = malloc(pairs_num * 2 * sizeof(pthread_t));
     waiting_for_pair = malloc(pairs_num * sizeof(int));
+    pair_tables = malloc(pairs_num * sizeof(int));
     waiting_for_pair_cond = malloc(pairs_num * sizeof(pthread_cond_t));
     waiting_for_pair_mutex = malloc(pairs_num * sizeof(pthread_mutex_t));
-    if (threads_ids == NULL || waiting_for_pair_cond == NULL || waiting_for_pair_mutex == NULL) {
+    persons_stats = aligned_alloc(CACHE_LINE_SIZE, pairs_num * 2 * sizeof(struct person_stats));
+    if (threads_ids == NULL || waiting_for_pair == NULL || pair_tables == NULL || waiting_for_pair_cond == NULL ||
+        waiting_for_pair_mutex == NULL || persons_stats == NULL) {
         printf("Error while allocating memory occurred.\n");
         return 1;
     }
@@ -54,8 +98,16 @@ int main(int argc, char *argv[]) {
         pthread_mutex_init(&waiting_for_pair_mutex[i], NULL);
         pthread_cond_init(&waiting_for_pair_cond[i], NULL);
     }
+    for (int i = 0; i < pairs_num * 2; i++) {
+        persons_stats[i].seated_pairs = persons_stats[i].wakeups = 0;
+        histogram_init(&persons_stats[i].pair_wait);
+    }
     pthread_mutex_init(&waiting_for_table_mutex, NULL);
     pthread_cond_init(&waiting_for_table_cond, NULL);
+    if (mode->init != NULL && mode->init() != 0)
+        return 1;
+    if (rendezvous && rendezvous_init() != 0)
+        return 1;
     pthread_key_create(&table_locked_key, NULL);
     pthread_key_create(&pair_locked_key, NULL);
     // prepare mask for persons' threads (after that, only main thread will catch signals).
@@ -63,11 +115,14 @@ int main(int argc, char *argv[]) {
     sigset_t old_signal_mask;
     sigfillset(&signal_mask);
     pthread_sigmask(SIG_SETMASK, &signal_mask, &old_signal_mask);
+    if (bench_seconds > 0)
+        return run_bench(&old_signal_mask);
     for (int i = 0; i < pairs_num * 2; i++) {
         if (pthread_create(&(threads_ids[i]), NULL, person_thread, NULL) != 0) {
             printf("Error while creating new thread occurred.\n");
             break;
         }
+        threads_started++;
     }
     pthread_sigmask(SIG_SETMASK, &old_signal_mask, NULL);
 
@@ -75,71 +130,116 @@ int main(int argc, char *argv[]) {
         pause();
 }
 
+int get_person_id() {
+    for (int i = 0; i < pairs_num * 2; i++) {
+        if (pthread_equal(threads_ids[i], pthread_self()))
+            return i;
+    }
+    return 0;
+}
+
+// in bench persons sit down and stand up again without sleeps, until main thread cancels them.
 void *person_thread(void *arg) {
     pthread_cleanup_push(thread_cleanup, NULL);
-            int person_id = 0;
-            for (int i = 0; i < pairs_num * 2; i++) {
-                if (pthread_equal(threads_ids[i], pthread_self())) {
-                    person_id = i;
-                    break;
-                }
-            }
             int * table_locked = malloc(sizeof(int));
             int * pair_locked = malloc(sizeof(int));
             *table_locked = 0;
             *pair_locked = 0;
             pthread_setspecific(table_locked_key, table_locked);
             pthread_setspecific(pair_locked_key, pair_locked);
+            int person_id = get_person_id();
+            rng_seed_thread(person_id);
+            pin_thread("Person", person_id, person_id);
+            if (bench_seconds > 0)
+                pthread_barrier_wait(&bench_barrier);
             unsigned int min_time = 500000, max_time = 1000000;
             while (1) {
-                usleep(random_utime(min_time, max_time));
-                get_table(person_id);
-                usleep(random_utime(min_time, max_time));
-                release_table(person_id);
+                if (bench_seconds == 0)
+                    usleep(random_utime(min_time, max_time));
+                int table = get_table(person_id);
+                metrics_count(person_id, 0);
+                if (stress != NULL)
+                    stress_table_taken(person_id, table);
+                if (bench_seconds == 0)
+                    usleep(random_utime(min_time, max_time));
+                if (stress != NULL)
+                    stress_table_left(person_id, table);
+                release_table(person_id, table);
+                pthread_testcancel();
             }
     pthread_cleanup_pop(1);
     return NULL;
 }
 
-void get_table(int id) {
+// waiting_for_pair: 0 - nobody is waiting, 1 - the first person is waiting, 2 - the pair got a table,
+// but the first person has not noticed it yet (without sleeps the second one can be back before that).
+int get_table(int id) {
+    if (rendezvous)
+        return rendezvous_get_table(id);
     int abs_id = id % pairs_num;
     int is_first_in_pair = 0;
-    int *table_locked = pthread_getspecific(table_locked_key);
     int *pair_locked = pthread_getspecific(pair_locked_key);
     pthread_mutex_lock(&waiting_for_pair_mutex[abs_id]);
     *pair_locked = 1;
-    printf("%d is waiting for the second person.\n", id);
-    while (waiting_for_pair[abs_id] == 0) {
+    if (verbose)
+        evlog(EVENT_WAITING_FOR_PERSON, id, 0, 0, 0, 0);
+    while (waiting_for_pair[abs_id] == 2)
+        pthread_cond_wait(&waiting_for_pair_cond[abs_id], &waiting_for_pair_mutex[abs_id]);
+    if (waiting_for_pair[abs_id] == 0) {
         is_first_in_pair = 1;
         waiting_for_pair[abs_id] = 1;
-        pthread_cond_wait(&waiting_for_pair_cond[abs_id], &waiting_for_pair_mutex[abs_id]);
+        while (waiting_for_pair[abs_id] != 2)
+            pthread_cond_wait(&waiting_for_pair_cond[abs_id], &waiting_for_pair_mutex[abs_id]);
     }
     if (!is_first_in_pair) {
-        pthread_mutex_lock(&waiting_for_table_mutex);
-        *table_locked = 1;
-        printf("Pair %d and %d is complete. Waiting for table.\n", abs_id, abs_id + pairs_num);
-        while (using_table > 0) {
-            pthread_cond_wait(&waiting_for_table_cond, &waiting_for_table_mutex);
-        }
-        using_table = 2;
-        printf("Pair %d and %d got a table.\n", abs_id, abs_id + pairs_num);
-        pthread_cond_signal(&waiting_for_pair_cond[abs_id]);
-        pthread_mutex_unlock(&waiting_for_table_mutex);
-        *table_locked = 0;
+        if (verbose)
+            evlog(EVENT_PAIR_COMPLETE, abs_id, abs_id + pairs_num, 0, 0, 0);
+        uint64_t wait_start = bench_now_ns();
+        pair_tables[abs_id] = mode->seat_pair(id);
+        histogram_record(&persons_stats[id].pair_wait, bench_now_ns() - wait_start);
+        persons_stats[id].seated_pairs++;
+        if (verbose && mode == &single_mode)
+            evlog(EVENT_GOT_A_TABLE, abs_id, abs_id + pairs_num, 0, 0, 0);
+        else if (verbose)
+            evlog(EVENT_GOT_TABLE, abs_id, abs_id + pairs_num, pair_tables[abs_id], 0, 0);
+        waiting_for_pair[abs_id] = 2;
+        pthread_cond_broadcast(&waiting_for_pair_cond[abs_id]);
     }
     else {
         waiting_for_pair[abs_id] = 0;
+        pthread_cond_broadcast(&waiting_for_pair_cond[abs_id]);
     }
+    int table = pair_tables[abs_id];
     pthread_mutex_unlock(&waiting_for_pair_mutex[abs_id]);
     *pair_locked = 0;
+    return table;
+}
+
+void release_table(int id, int table) {
+    mode->release_table(id, table);
+}
+
+int single_seat_pair(int id) {
+    int *table_locked = pthread_getspecific(table_locked_key);
+    pthread_mutex_lock(&waiting_for_table_mutex);
+    *table_locked = 1;
+    while (using_table > 0) {
+        pthread_cond_wait(&waiting_for_table_cond, &waiting_for_table_mutex);
+        persons_stats[id].wakeups++;
+    }
+    using_table = 2;
+    pthread_mutex_unlock(&waiting_for_table_mutex);
+    *table_locked = 0;
+    return 0;
 }
 
-void release_table(int id) {
+void single_release_table(int id, int table) {
     int *table_locked = pthread_getspecific(table_locked_key);
     pthread_mutex_lock(&waiting_for_table_mutex);
     *table_locked = 1;
     using_table--;
-    printf("%d released the table.\n", id);
+    if (verbose)
+        evlog(EVENT_RELEASED_THE_TABLE, id, 0, 0, 0, 0);
     if (using_table == 0) {
         pthread_cond_signal(&waiting_for_table_cond);
     }
@@ -147,12 +247,81 @@ void release_table(int id) {
     *table_locked = 0;
 }
 
+// shadow t holds the number of persons at table t in its low 16 bits and the sum of their pair numbers (counted
+// from 1) above them. A person is counted only while it holds the table, and a table is given to the next pair
+// only after both persons left it, so two persons from different pairs or a third person is a violation.
+long long stress_person_delta(int id) {
+    return 1 + ((long long)(id % pairs_num + 1) << 16);
+}
+
+void stress_table_taken(int id, int table) {
+    if (table < 0 || table >= tables_num) {
+        stress_violation("%d got table %d of %d.", id, table, tables_num);
+        return;
+    }
+    long long value = stress_add(table, stress_person_delta(id));
+    long long persons = value & 0xffff;
+    if (persons > 2 || (value >> 16) != persons * (id % pairs_num + 1))
+        stress_violation("%d sat at table %d with %lld persons not all from pair %d.", id, table, persons,
+                         id % pairs_num);
+}
+
+void stress_table_left(int id, int table) {
+    if (table >= 0 && table < tables_num)
+        stress_add(table, -stress_person_delta(id));
+}
+
 unsigned int random_utime(unsigned int min, unsigned int max) {
-    return ((unsigned)rand() % (max - min)) + min;
+    return rng_range(min, max);
+}
+
+// persons may wait for each other forever once the run is over, so they are cancelled instead of stopped.
+int run_bench(sigset_t *old_signal_mask) {
+    verbose = 0;
+    pthread_barrier_init(&bench_barrier, NULL, pairs_num * 2 + 1);
+    for (int i = 0; i < pairs_num * 2; i++) {
+        if (pthread_create(&(threads_ids[i]), NULL, person_thread, NULL) != 0) {
+            printf("Error while creating new thread occurred.\n");
+            exit(1);
+        }
+        threads_started++;
+    }
+    pthread_sigmask(SIG_SETMASK, old_signal_mask, NULL);
+    pthread_barrier_wait(&bench_barrier);
+    uint64_t start = bench_now_ns();
+    bench_sleep(bench_seconds);
+    for (int i = 0; i < threads_started; i++)
+        pthread_cancel(threads_ids[i]);
+    for (int i = 0; i < threads_started; i++)
+        pthread_join(threads_ids[i], NULL);
+    threads_started = 0;
+    double elapsed = (double)(bench_now_ns() - start) / 1e9;
+    pthread_barrier_destroy(&bench_barrier);
+    print_bench_report(elapsed);
+    return stress != NULL ? stress_report() : 0;
+}
+
+void print_bench_report(double elapsed) {
+    struct latency_histogram pair_wait;
+    unsigned long seated_pairs = 0, wakeups = 0;
+    histogram_init(&pair_wait);
+    for (int i = 0; i < pairs_num * 2; i++) {
+        seated_pairs += persons_stats[i].seated_pairs;
+        wakeups += persons_stats[i].wakeups;
+        histogram_merge(&pair_wait, &persons_stats[i].pair_wait);
+    }
+    printf("Table %s (%s, %d tables, %s pairing): %d pairs, %.2f s\n", stress_mode ? "stress test" : "benchmark",
+           mode->name, tables_num, rendezvous ? "rendezvous" : "mutex", pairs_num, elapsed);
+    printf("Operations: %lu\n", seated_pairs);
+    printf("Throughput: %.1f seated pairs/s\n", (double)seated_pairs / elapsed);
+    printf("Wakeups per seated pair: %.3f\n", seated_pairs == 0 ? 0.0 : (double)wakeups / (double)seated_pairs);
+    printf("Pair wait: mean %.0f ns, p50 %llu ns, p99 %llu ns, max %llu ns\n", histogram_mean(&pair_wait),
+           (unsigned long long)histogram_percentile(&pair_wait, 0.5),
+           (unsigned long long)histogram_percentile(&pair_wait, 0.99), (unsigned long long)pair_wait.max);
 }
 
 int read_args(int argc, char *argv[], int *pairs_num) {
-    if (argc != 2) {
+    if (argc < 2) {
         printf("Incorrect number of arguments.\n");
         return 1;
     }
@@ -162,18 +331,35 @@ int read_args(int argc, char *argv[], int *pairs_num) {
         printf("Incorrect number of pairs. It should be > 0.\n");
         return 1;
     }
+    if (arg_num < argc && strcmp(argv[arg_num], "tables") == 0) {
+        arg_num++;
+        mode = &tables_mode;
+        if (arg_num == argc || (tables_num = atoi(argv[arg_num++])) < 1 || tables_num > MAX_TABLES) {
+            printf("Incorrect number of tables. It should be > 0 and <= %d.\n", MAX_TABLES);
+            return 1;
+        }
+    }
+    if (arg_num < argc && strcmp(argv[arg_num], "rendezvous") == 0) {
+        arg_num++;
+        rendezvous = 1;
+    }
+    if (arg_num < argc && (strcmp(argv[arg_num], "bench") == 0 || strcmp(argv[arg_num], "stress") == 0)) {
+        stress_mode = strcmp(argv[arg_num++], "stress") == 0;
+        if (arg_num == argc || (bench_seconds = atof(argv[arg_num++])) <= 0) {
+            printf("Incorrect number of seconds. It should be > 0.\n");
+            return 1;
+        }
+    }
+    if (arg_num != argc) {
+        printf("Incorrect number of arguments.\n");
+        return 1;
+    }
 
     return 0;
 }
 
 void thread_cleanup(void *args) {
-    int person_id = 0;
-    for (int i = 0; i < pairs_num * 2; i++) {
-        if (pthread_equal(threads_ids[i], pthread_self())) {
-            person_id = i;
-            break;
-        }
-    }
+    int person_id = get_person_id();
     if (*(int *)pthread_getspecific(table_locked_key) == 1)
         pthread_mutex_unlock(&waiting_for_table_mutex);
     if (*(int *)pthread_getspecific(pair_locked_key) == 1)
@@ -183,21 +369,31 @@ void thread_cleanup(void *args) {
 }
 
 void cleanup() {
-    for (int i = 0; i < pairs_num * 2; i++)
+    for (int i = 0; i < threads_started; i++)
         pthread_cancel(threads_ids[i]);
-    for (int i = 0; i < pairs_num * 2; i++)
+    for (int i = 0; i < threads_started; i++)
         pthread_join(threads_ids[i], NULL);
-    for (int i = 0; i < pairs_num; i++) {
+    for (int i = 0; waiting_for_pair_cond != NULL && waiting_for_pair_mutex != NULL && i < pairs_num; i++) {
         pthread_cond_destroy(&waiting_for_pair_cond[i]);
         pthread_mutex_destroy(&waiting_for_pair_mutex[i]);
     }
+    if (mode->destroy != NULL)
+        mode->destroy();
+    if (rendezvous)
+        rendezvous_destroy();
     pthread_cond_destroy(&waiting_for_table_cond);
     pthread_mutex_destroy(&waiting_for_table_mutex);
     pthread_key_delete(table_locked_key);
     pthread_key_delete(pair_locked_key);
     free(threads_ids);
+    free(waiting_for_pair);
+    free(pair_tables);
     free(waiting_for_pair_cond);
     free(waiting_for_pair_mutex);
+    free(persons_stats);
+    evlog_close();
+    metrics_destroy();
+    stress_destroy();
 }
 
 void sigint_handler(int signum) {
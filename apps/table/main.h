@@ -0,0 +1,52 @@
+#ifndef TABLE_MAIN_H
+#define TABLE_MAIN_H
+
+#include "../common/bench.h"
+#include "../common/evlog.h"
+#include "../common/rng.h"
+#include "../common/pin.h"
+#include "../common/metrics.h"
+#include "../common/stress.h"
+#include "../common/lockprof.h"
+
+#define MAX_TABLES 4096
+
+enum table_event {
+    EVENT_WAITING_FOR_PERSON,
+    EVENT_PAIR_COMPLETE,
+    EVENT_GOT_A_TABLE,
+    EVENT_GOT_TABLE,
+    EVENT_RELEASED_THE_TABLE,
+    EVENT_RELEASED_TABLE,
+    EVENTS_NUM
+};
+
+// seat_pair is called by the person completing the pair and returns the table for both of them,
+// release_table is called by each of them once.
+struct table_mode {
+    char *name;
+    int (*init)();
+    int (*seat_pair)(int id);
+    void (*release_table)(int id, int table);
+    void (*destroy)();
+};
+
+struct person_stats {
+    unsigned long seated_pairs;
+    unsigned long wakeups;
+    struct latency_histogram pair_wait;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+extern int pairs_num, tables_num;
+extern int verbose;
+extern struct table_mode *mode;
+extern struct person_stats *persons_stats;
+
+extern struct table_mode single_mode;
+extern struct table_mode tables_mode;
+
+int rendezvous_init();
+int rendezvous_get_table(int id);
+void rendezvous_destroy();
+
+#endif //TABLE_MAIN_H
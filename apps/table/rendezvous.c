@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sched.h>
+#include "../common/futex.h"
+#include "main.h"
+
+// one padded word per pair: 0 - nobody is waiting, 1 - the first person is waiting, 2 - the pair is complete,
+// 3 + table - the pair got the table and the first person has not taken it yet.
+#define SLOT_FREE 0
+#define SLOT_WAITING 1
+#define SLOT_MATCHED 2
+#define SLOT_SEATED 3
+
+struct pair_slot {
+    atomic_int state;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct pair_slot *pair_slots;
+
+int rendezvous_init() {
+    pair_slots = aligned_alloc(CACHE_LINE_SIZE, pairs_num * sizeof(struct pair_slot));
+    if (pair_slots == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < pairs_num; i++)
+        atomic_init(&pair_slots[i].state, SLOT_FREE);
+    return 0;
+}
+
+// the first person publishes itself and sleeps, the second one completes the match with CAS, seats the pair
+// and hands the table over through the same word. Only the first one ever sleeps.
+int rendezvous_get_table(int id) {
+    int abs_id = id % pairs_num;
+    atomic_int *state = &pair_slots[abs_id].state;
+    if (verbose)
+        evlog(EVENT_WAITING_FOR_PERSON, id, 0, 0, 0, 0);
+    int expected = atomic_load(state);
+    while (1) {
+        if (expected >= SLOT_SEATED) {
+            // the partner has not taken the previous table yet, it is already running, so just let it go.
+            sched_yield();
+            pthread_testcancel();
+            expected = atomic_load(state);
+        }
+        else if (expected == SLOT_FREE) {
+            if (atomic_compare_exchange_weak(state, &expected, SLOT_WAITING)) {
+                int value;
+                while ((value = atomic_load(state)) < SLOT_SEATED)
+                    futex_wait(state, value);
+                atomic_store(state, SLOT_FREE);
+                return value - SLOT_SEATED;
+            }
+        }
+        else if (atomic_compare_exchange_weak(state, &expected, SLOT_MATCHED)) {
+            break;
+        }
+    }
+    if (verbose)
+        evlog(EVENT_PAIR_COMPLETE, abs_id, abs_id + pairs_num, 0, 0, 0);
+    uint64_t wait_start = bench_now_ns();
+    int table = mode->seat_pair(id);
+    histogram_record(&persons_stats[id].pair_wait, bench_now_ns() - wait_start);
+    persons_stats[id].seated_pairs++;
+    if (verbose)
+        evlog(EVENT_GOT_TABLE, abs_id, abs_id + pairs_num, table, 0, 0);
+    atomic_store(state, SLOT_SEATED + table);
+    futex_wake(state, 1);
+    return table;
+}
+
+void rendezvous_destroy() {
+    free(pair_slots);
+}
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "../common/futex.h"
+#include "main.h"
+
+int tables_init();
+int tables_seat_pair(int id);
+void tables_release_table(int id, int table);
+void tables_destroy();
+
+struct table_mode tables_mode = {
+        "tables", tables_init, tables_seat_pair, tables_release_table, tables_destroy
+};
+
+// complete pair waiting for a table. The table is written to it by the person freeing one, 0 means not yet seated.
+struct pair_waiter {
+    atomic_int table_plus_one;
+    int table;
+    struct pair_waiter *next;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct table_occupants {
+    atomic_int persons;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+// bit set - table is free.
+_Atomic uint64_t free_tables[(MAX_TABLES + 63) / 64] __attribute__((aligned(CACHE_LINE_SIZE)));
+int free_tables_words;
+struct table_occupants *occupants;
+struct pair_waiter *pair_waiters;
+// waiting pairs in FIFO order, the mutex is never held while sleeping.
+pthread_mutex_t waiting_pairs_mutex = PTHREAD_MUTEX_INITIALIZER;
+struct pair_waiter *waiting_head, *waiting_tail;
+atomic_int waiting_pairs __attribute__((aligned(CACHE_LINE_SIZE)));
+
+int tables_init() {
+    free_tables_words = (tables_num + 63) / 64;
+    for (int i = 0; i < free_tables_words; i++) {
+        int bits = tables_num - i * 64;
+        atomic_init(&free_tables[i], bits >= 64 ? UINT64_MAX : (1ull << bits) - 1);
+    }
+    occupants = aligned_alloc(CACHE_LINE_SIZE, tables_num * sizeof(struct table_occupants));
+    pair_waiters = aligned_alloc(CACHE_LINE_SIZE, pairs_num * sizeof(struct pair_waiter));
+    if (occupants == NULL || pair_waiters == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        return 1;
+    }
+    for (int i = 0; i < tables_num; i++)
+        atomic_init(&occupants[i].persons, 0);
+    for (int i = 0; i < pairs_num; i++)
+        atomic_init(&pair_waiters[i].table_plus_one, 0);
+    waiting_head = waiting_tail = NULL;
+    atomic_init(&waiting_pairs, 0);
+    return 0;
+}
+
+int claim_table(int start_word) {
+    for (int n = 0; n < free_tables_words; n++) {
+        int word = (start_word + n) % free_tables_words;
+        uint64_t bits = atomic_load_explicit(&free_tables[word], memory_order_relaxed);
+        while (bits != 0) {
+            int bit = __builtin_ctzll(bits);
+            if (atomic_compare_exchange_weak_explicit(&free_tables[word], &bits, bits & ~(1ull << bit),
+                                                      memory_order_acquire, memory_order_relaxed))
+                return word * 64 + bit;
+        }
+    }
+    return -1;
+}
+
+// seats as many waiting pairs as there are free tables in one pass, must be called with waiting_pairs_mutex locked.
+// Seated pairs are returned as a list, so they can be woken after unlocking.
+struct pair_waiter *seat_waiting_pairs() {
+    struct pair_waiter *seated = NULL, *seated_tail = NULL;
+    int table;
+    while (waiting_head != NULL && (table = claim_table(0)) >= 0) {
+        struct pair_waiter *waiter = waiting_head;
+        waiting_head = waiter->next;
+        if (waiting_head == NULL)
+            waiting_tail = NULL;
+        atomic_fetch_sub(&waiting_pairs, 1);
+        atomic_store(&occupants[table].persons, 2);
+        waiter->next = NULL;
+        if (seated_tail != NULL)
+            seated_tail->next = waiter;
+        else
+            seated = waiter;
+        seated_tail = waiter;
+        waiter->table = table;
+    }
+    return seated;
+}
+
+// wakes exactly the seated pairs, nobody else is disturbed.
+void wake_seated_pairs(struct pair_waiter *seated) {
+    while (seated != NULL) {
+        // the table is published last, after that the pair may already be gone.
+        struct pair_waiter *next = seated->next;
+        atomic_store(&seated->table_plus_one, seated->table + 1);
+        futex_wake(&seated->table_plus_one, 1);
+        seated = next;
+    }
+}
+
+int tables_seat_pair(int id) {
+    int pair_id = id % pairs_num;
+    int table;
+    // nobody is waiting, so the pair can take any free table without queueing.
+    if (atomic_load(&waiting_pairs) == 0 && (table = claim_table(pair_id % free_tables_words)) >= 0) {
+        atomic_store(&occupants[table].persons, 2);
+        return table;
+    }
+    struct pair_waiter *waiter = &pair_waiters[pair_id];
+    atomic_store(&waiter->table_plus_one, 0);
+    pthread_mutex_lock(&waiting_pairs_mutex);
+    waiter->next = NULL;
+    if (waiting_tail != NULL)
+        waiting_tail->next = waiter;
+    else
+        waiting_head = waiter;
+    waiting_tail = waiter;
+    atomic_fetch_add(&waiting_pairs, 1);
+    // a table might have been freed before waiting_pairs was increased.
+    struct pair_waiter *seated = seat_waiting_pairs();
+    pthread_mutex_unlock(&waiting_pairs_mutex);
+    wake_seated_pairs(seated);
+
+    while ((table = atomic_load(&waiter->table_plus_one) - 1) < 0) {
+        futex_wait(&waiter->table_plus_one, 0);
+        persons_stats[id].wakeups++;
+    }
+    return table;
+}
+
+void tables_release_table(int id, int table) {
+    if (verbose)
+        evlog(EVENT_RELEASED_TABLE, id, table, 0, 0, 0);
+    if (atomic_fetch_sub(&occupants[table].persons, 1) != 1)
+        return;
+    atomic_fetch_or_explicit(&free_tables[table / 64], 1ull << (table % 64), memory_order_release);
+    if (atomic_load(&waiting_pairs) > 0) {
+        pthread_mutex_lock(&waiting_pairs_mutex);
+        struct pair_waiter *seated = seat_waiting_pairs();
+        pthread_mutex_unlock(&waiting_pairs_mutex);
+        wake_seated_pairs(seated);
+    }
+}
+
+void tables_destroy() {
+    pthread_mutex_destroy(&waiting_pairs_mutex);
+    free(occupants);
+    free(pair_waiters);
+}
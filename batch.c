@@ -0,0 +1,454 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <time.h>
+#include <wordexp.h>
+#include <spawn.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "apps/common/metrics.h"
+#include "main.h"
+
+// Batch mode runs every case of a scenario file without the prompt. Each scenario line is:
+//   <app> <duration> <repeat> <args>
+// where app is a number or a key (aircraft, philosophers, cp, rw, table, printers, or sync for the microbenchmarks),
+// duration is the deadline in seconds (0 means no deadline), and args may contain grids like {8,64} or {1..4},
+// expanded to all combinations. Lines starting with # are comments. A run still alive at its deadline gets SIGINT,
+// and SIGKILL after a grace time. Just before the SIGINT the live counters of the run are recorded as rates.
+// Results go to a CSV file and, if asked for, to a JSON file with the same records.
+#define MAX_LINE_LENGTH 1024
+#define KILL_GRACE_NS 2000000000ull
+
+struct batch_case {
+    int app_id;
+    double duration;
+    int repeat;
+    char args[MAX_ARGS_LENGTH];
+};
+
+struct batch_run {
+    pid_t pid;
+    int run_id;
+    struct batch_case *batch_case;
+    uint64_t start_time;
+    uint64_t deadline;
+    int timed_out;
+    double operations;
+    FILE *output;
+};
+
+struct batch_case *cases = NULL;
+int cases_num = 0, cases_capacity = 0;
+struct batch_run *runs;
+int parallel = 1, running = 0;
+FILE *csv;
+FILE *json = NULL;
+int json_records = 0;
+volatile sig_atomic_t batch_interrupted = 0;
+
+extern char **environ;
+
+void batch_sigint_handler(int signum) {
+    batch_interrupted = 1;
+}
+
+int find_app(char *name) {
+    int app_id = atoi(name);
+    if (app_id > 0 && app_id <= apps_num)
+        return app_id - 1;
+    for (int i = 0; i < apps_num + tools_num; i++)
+        if (strcmp(name, apps_keys[i]) == 0)
+            return i;
+    return -1;
+}
+
+int add_case(int app_id, double duration, int repeat, char *args) {
+    if (cases_num == cases_capacity) {
+        cases_capacity = cases_capacity == 0 ? 64 : cases_capacity * 2;
+        struct batch_case *new_cases = realloc(cases, cases_capacity * sizeof(struct batch_case));
+        if (new_cases == NULL) {
+            printf("Error while allocating memory occurred.\n");
+            return 1;
+        }
+        cases = new_cases;
+    }
+    struct batch_case *batch_case = &cases[cases_num++];
+    batch_case->app_id = app_id;
+    batch_case->duration = duration;
+    batch_case->repeat = repeat;
+    strcpy(batch_case->args, args);
+    return 0;
+}
+
+// expands the first grid of args and recurses on every alternative, so all grids give a cartesian product.
+int expand_grid(int app_id, double duration, int repeats, char *args) {
+    char *open = strchr(args, '{');
+    if (open == NULL) {
+        for (int i = 0; i < repeats; i++)
+            if (add_case(app_id, duration, i + 1, args) != 0)
+                return 1;
+        return 0;
+    }
+    char *close = strchr(open, '}');
+    if (close == NULL) {
+        printf("Unterminated grid in: %s\n", args);
+        return 1;
+    }
+    char alternatives[MAX_ARGS_LENGTH], expanded[MAX_ARGS_LENGTH];
+    size_t prefix_length = open - args;
+    strncpy(alternatives, open + 1, close - open - 1);
+    alternatives[close - open - 1] = '\0';
+
+    int from, to;
+    char range_end;
+    if (sscanf(alternatives, "%d..%d%c", &from, &to, &range_end) == 2) {
+        int step = from <= to ? 1 : -1;
+        for (int value = from; value != to + step; value += step) {
+            if (snprintf(expanded, MAX_ARGS_LENGTH, "%.*s%d%s", (int)prefix_length, args, value, close + 1) >=
+                    MAX_ARGS_LENGTH || expand_grid(app_id, duration, repeats, expanded) != 0)
+                return 1;
+        }
+        return 0;
+    }
+    char *saveptr;
+    for (char *alternative = strtok_r(alternatives, ",", &saveptr); alternative != NULL;
+            alternative = strtok_r(NULL, ",", &saveptr)) {
+        if (snprintf(expanded, MAX_ARGS_LENGTH, "%.*s%s%s", (int)prefix_length, args, alternative, close + 1) >=
+                MAX_ARGS_LENGTH || expand_grid(app_id, duration, repeats, expanded) != 0)
+            return 1;
+    }
+    return 0;
+}
+
+int read_scenario(char *file_name) {
+    FILE *scenario = fopen(file_name, "r");
+    if (scenario == NULL) {
+        printf("Error while opening scenario file %s occurred.\n", file_name);
+        return 1;
+    }
+    char line[MAX_LINE_LENGTH], app_name[64];
+    int line_num = 0;
+    while (fgets(line, MAX_LINE_LENGTH, scenario) != NULL) {
+        line_num++;
+        line[strcspn(line, "\r\n")] = '\0';
+        char *start = line;
+        while (isspace((unsigned char)*start))
+            start++;
+        if (*start == '\0' || *start == '#')
+            continue;
+        double duration;
+        int repeats, args_offset = 0;
+        if (sscanf(start, "%63s %lf %d %n", app_name, &duration, &repeats, &args_offset) != 3 || args_offset == 0) {
+            printf("Line %d: expected app, duration, repeat count and args.\n", line_num);
+            fclose(scenario);
+            return 1;
+        }
+        int app_id = find_app(app_name);
+        if (app_id < 0 || duration < 0 || repeats < 1) {
+            printf("Line %d: incorrect app, duration or repeat count.\n", line_num);
+            fclose(scenario);
+            return 1;
+        }
+        if (expand_grid(app_id, duration, repeats, start + args_offset) != 0) {
+            printf("Line %d: incorrect args grid.\n", line_num);
+            fclose(scenario);
+            return 1;
+        }
+    }
+    fclose(scenario);
+    return 0;
+}
+
+void write_json_string(FILE *file, char *string) {
+    fputc('"', file);
+    for (char *c = string; *c != '\0'; c++) {
+        if (*c == '"' || *c == '\\')
+            fputc('\\', file);
+        fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+void write_value(struct batch_run *run, char *metric, double value) {
+    fprintf(csv, "%d,%s,\"", run->run_id + 1, apps_keys[run->batch_case->app_id]);
+    for (char *c = run->batch_case->args; *c != '\0'; c++) {
+        if (*c == '"')
+            fputc('"', csv);
+        fputc(*c, csv);
+    }
+    fprintf(csv, "\",%d,%s,%.10g\n", run->batch_case->repeat, metric, value);
+    if (json == NULL)
+        return;
+    fprintf(json, "%s\n  {\"run\": %d, \"app\": \"%s\", \"args\": ", json_records++ > 0 ? "," : "",
+            run->run_id + 1, apps_keys[run->batch_case->app_id]);
+    write_json_string(json, run->batch_case->args);
+    fprintf(json, ", \"repeat\": %d, \"metric\": ", run->batch_case->repeat);
+    write_json_string(json, metric);
+    fprintf(json, ", \"value\": %.10g}", value);
+}
+
+// apps that run until they are stopped (cp, rw) report nothing themselves, so their counters are read instead.
+void record_live_metrics(struct batch_run *run) {
+    struct metrics_view view;
+    if (metrics_view_open(&view, run->pid) != 0)
+        return;
+    struct metrics_segment *segment = view.segment;
+    double elapsed = (double)(launcher_now_ns() - run->start_time) / 1e9;
+    for (int j = 0; j < segment->counters_num; j++) {
+        // a freshly opened view holds the totals as its previous sample.
+        uint64_t total = 0;
+        for (int i = 0; i < segment->entities_num; i++)
+            total += view.previous[i * segment->counters_num + j];
+        char name[METRICS_LABEL_LENGTH + 16];
+        snprintf(name, sizeof name, "%s per second", segment->counters_names[j]);
+        write_value(run, name, (double)total / elapsed);
+    }
+    metrics_view_close(&view);
+}
+
+// turns the report lines of the apps into metrics, e.g. "Throughput: 1.5 meals/s" gives Throughput,
+// "Land wait: mean 10 ns, p99 20 ns" gives "Land wait mean" and "Land wait p99",
+// "Landings: 5, starts: 4" gives Landings and starts.
+void parse_report_line(struct batch_run *run, char *line) {
+    char *colon = strstr(line, ": ");
+    if (colon == NULL || colon == line)
+        return;
+    // titles like "Printers benchmark (mutex): 8 printers" are not metrics.
+    for (char *c = line; c < colon; c++)
+        if (!isalpha((unsigned char)*c) && *c != ' ')
+            return;
+    *colon = '\0';
+    char *key = line, *saveptr;
+    for (char *piece = strtok_r(colon + 2, ",", &saveptr); piece != NULL; piece = strtok_r(NULL, ",", &saveptr)) {
+        char name[2 * MAX_LINE_LENGTH], word[MAX_LINE_LENGTH];
+        double value;
+        while (isspace((unsigned char)*piece))
+            piece++;
+        if (sscanf(piece, "%lf", &value) == 1) {
+            if (strcmp(key, "Operations") == 0)
+                run->operations += value;
+            write_value(run, key, value);
+            continue;
+        }
+        if (sscanf(piece, "%s %lf", word, &value) != 2)
+            return;
+        size_t word_length = strlen(word);
+        if (word[word_length - 1] == ':') {
+            word[word_length - 1] = '\0';
+            write_value(run, word, value);
+        }
+        else {
+            snprintf(name, sizeof name, "%s %s", key, word);
+            write_value(run, name, value);
+        }
+    }
+}
+
+int start_run(struct batch_run *run, int run_id, char *main_path, sigset_t *old_mask) {
+    struct batch_case *batch_case = &cases[run_id];
+    char command[MAX_PATH_LENGTH + MAX_ARGS_LENGTH + 1];
+    char *app_path = get_app_path(batch_case->app_id, main_path);
+    snprintf(command, sizeof command, "%s %s", app_path, batch_case->args);
+    free(app_path);
+    wordexp_t parsed_args;
+    if (wordexp(command, &parsed_args, WRDE_NOCMD) != 0) {
+        printf("Incorrect arguments: %s\n", batch_case->args);
+        return 1;
+    }
+    run->output = tmpfile();
+    if (run->output == NULL) {
+        printf("Error while creating output file occurred.\n");
+        wordfree(&parsed_args);
+        return 1;
+    }
+    run->run_id = run_id;
+    run->batch_case = batch_case;
+    run->timed_out = 0;
+    run->operations = 0;
+    run->start_time = launcher_now_ns();
+    run->deadline = batch_case->duration > 0 ? run->start_time + (uint64_t)(batch_case->duration * 1e9) : 0;
+    // own process group, so helpers started by the app (cp_producer, rw_reader...) can be killed with it.
+    posix_spawnattr_t spawn_attr;
+    posix_spawn_file_actions_t file_actions;
+    posix_spawnattr_init(&spawn_attr);
+    posix_spawnattr_setsigmask(&spawn_attr, old_mask);
+    posix_spawnattr_setpgroup(&spawn_attr, 0);
+    posix_spawnattr_setflags(&spawn_attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP);
+    posix_spawn_file_actions_init(&file_actions);
+    posix_spawn_file_actions_adddup2(&file_actions, fileno(run->output), STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&file_actions, fileno(run->output), STDERR_FILENO);
+    int spawn_ret = posix_spawn(&run->pid, parsed_args.we_wordv[0], &file_actions, &spawn_attr,
+                                parsed_args.we_wordv, environ);
+    posix_spawn_file_actions_destroy(&file_actions);
+    posix_spawnattr_destroy(&spawn_attr);
+    wordfree(&parsed_args);
+    if (spawn_ret != 0) {
+        printf("Error while creating new process occurred.\n");
+        fclose(run->output);
+        run->pid = 0;
+        return 1;
+    }
+    running++;
+    return 0;
+}
+
+// usage covers the whole process tree as long as the app waited for its own children (cp_main and rw_main do).
+void finish_run(struct batch_run *run, int status, struct rusage *usage) {
+    double wall_time = (double)(launcher_now_ns() - run->start_time) / 1e9;
+    double user_time = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6;
+    double sys_time = usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6;
+    int exit_status = WIFEXITED(status) ? WEXITSTATUS(status) : -WTERMSIG(status);
+    // the process group may still have orphaned helpers.
+    kill(-run->pid, SIGKILL);
+    printf("[%d/%d] %s %s (repeat %d): exit %d, %.2f s%s, user %.2f s, sys %.2f s, max RSS %ld KB, "
+           "%ld/%ld context switches\n", run->run_id + 1, cases_num, apps_keys[run->batch_case->app_id],
+           run->batch_case->args, run->batch_case->repeat, exit_status, wall_time,
+           run->timed_out ? " (killed at deadline)" : "", user_time, sys_time, usage->ru_maxrss, usage->ru_nvcsw,
+           usage->ru_nivcsw);
+    write_value(run, "exit status", exit_status);
+    write_value(run, "timed out", run->timed_out);
+    write_value(run, "wall time", wall_time);
+    write_value(run, "user time", user_time);
+    write_value(run, "sys time", sys_time);
+    write_value(run, "max RSS KB", (double)usage->ru_maxrss);
+    write_value(run, "voluntary context switches", (double)usage->ru_nvcsw);
+    write_value(run, "involuntary context switches", (double)usage->ru_nivcsw);
+    write_value(run, "minor page faults", (double)usage->ru_minflt);
+    write_value(run, "major page faults", (double)usage->ru_majflt);
+    char line[MAX_LINE_LENGTH];
+    rewind(run->output);
+    while (fgets(line, MAX_LINE_LENGTH, run->output) != NULL) {
+        line[strcspn(line, "\r\n")] = '\0';
+        parse_report_line(run, line);
+    }
+    if (run->operations > 0)
+        write_value(run, "context switches per operation",
+                        (double)(usage->ru_nvcsw + usage->ru_nivcsw) / run->operations);
+    fflush(csv);
+    fclose(run->output);
+    run->pid = 0;
+    running--;
+}
+
+void reap_runs() {
+    int status;
+    struct rusage usage;
+    pid_t pid;
+    while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0)
+        for (int i = 0; i < parallel; i++)
+            if (runs[i].pid == pid)
+                finish_run(&runs[i], status, &usage);
+}
+
+// sends SIGINT at the deadline (the apps exit cleanly on it) and SIGKILL to the whole group after the grace time.
+void check_deadlines(uint64_t now) {
+    for (int i = 0; i < parallel; i++) {
+        struct batch_run *run = &runs[i];
+        if (run->pid == 0 || run->deadline == 0 || now < run->deadline)
+            continue;
+        if (!run->timed_out) {
+            run->timed_out = 1;
+            record_live_metrics(run);
+            kill(run->pid, SIGINT);
+        }
+        else if (now >= run->deadline + KILL_GRACE_NS) {
+            kill(-run->pid, SIGKILL);
+        }
+    }
+}
+
+uint64_t next_deadline(uint64_t now) {
+    uint64_t next = now + 1000000000ull;
+    for (int i = 0; i < parallel; i++) {
+        struct batch_run *run = &runs[i];
+        if (run->pid == 0 || run->deadline == 0)
+            continue;
+        uint64_t deadline = run->timed_out ? run->deadline + KILL_GRACE_NS : run->deadline;
+        if (deadline < next)
+            next = deadline;
+    }
+    return next;
+}
+
+int run_batch(int argc, char *argv[]) {
+    char *csv_name = "results.csv", *json_name = NULL;
+    if (argc < 3) {
+        printf("Usage: %s batch <scenario file> [parallel N] [csv <file>] [json <file>]\n", argv[0]);
+        return 1;
+    }
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "parallel") == 0 && i + 1 < argc)
+            parallel = atoi(argv[++i]);
+        else if (strcmp(argv[i], "csv") == 0 && i + 1 < argc)
+            csv_name = argv[++i];
+        else if (strcmp(argv[i], "json") == 0 && i + 1 < argc)
+            json_name = argv[++i];
+        else
+            parallel = 0;
+    }
+    if (parallel < 1) {
+        printf("Incorrect batch arguments. Usage: %s batch <scenario file> [parallel N] [csv <file>] "
+               "[json <file>]\n", argv[0]);
+        return 1;
+    }
+    if (read_scenario(argv[2]) != 0)
+        return 1;
+    runs = calloc(parallel, sizeof(struct batch_run));
+    csv = fopen(csv_name, "w");
+    if (runs == NULL || csv == NULL) {
+        printf("Error while opening %s occurred.\n", csv_name);
+        return 1;
+    }
+    if (json_name != NULL && (json = fopen(json_name, "w")) == NULL) {
+        printf("Error while opening %s occurred.\n", json_name);
+        return 1;
+    }
+    fprintf(csv, "run,app,args,repeat,metric,value\n");
+    if (json != NULL)
+        fprintf(json, "[");
+    printf("Running %d runs, %d at a time, results in %s.\n", cases_num, parallel, csv_name);
+
+    struct sigaction act;
+    memset(&act, 0, sizeof act);
+    act.sa_handler = batch_sigint_handler;
+    sigaction(SIGINT, &act, NULL);
+    sigaction(SIGTERM, &act, NULL);
+    // SIGCHLD stays blocked and is only taken by sigtimedwait, so no exit is missed between the checks.
+    sigset_t chld_mask, old_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+
+    int next_run = 0;
+    while ((next_run < cases_num && !batch_interrupted) || running > 0) {
+        for (int i = 0; i < parallel && next_run < cases_num && !batch_interrupted; i++)
+            if (runs[i].pid == 0 && start_run(&runs[i], next_run++, argv[0], &old_mask) != 0)
+                batch_interrupted = 1;
+        if (batch_interrupted)
+            for (int i = 0; i < parallel; i++)
+                if (runs[i].pid != 0 && !runs[i].timed_out) {
+                    runs[i].timed_out = 1;
+                    runs[i].deadline = launcher_now_ns();
+                    kill(runs[i].pid, SIGINT);
+                }
+        uint64_t now = launcher_now_ns();
+        uint64_t next = next_deadline(now), timeout = next > now ? next - now : 0;
+        struct timespec wait_time = {(time_t)(timeout / 1000000000ull), (long)(timeout % 1000000000ull)};
+        sigtimedwait(&chld_mask, NULL, &wait_time);
+        reap_runs();
+        check_deadlines(launcher_now_ns());
+    }
+    fclose(csv);
+    if (json != NULL) {
+        fprintf(json, "\n]\n");
+        fclose(json);
+    }
+    free(runs);
+    free(cases);
+    printf("%s after %d of %d runs.\n", batch_interrupted ? "Batch interrupted" : "Batch finished", next_run, cases_num);
+    return batch_interrupted ? 1 : 0;
+}
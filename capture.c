@@ -0,0 +1,209 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "main.h"
+
+// Capture mode: the output of every job goes through a pipe to the launcher instead of the terminal.
+// One thread waits on all pipes with epoll, drains them with large non-blocking reads, writes the data to the
+// job's log and counts known event lines. Once a second it prints the rates of the running jobs.
+#define CAPTURE_BUFFER_SIZE (256 * 1024)
+#define CAPTURE_PIPE_SIZE (1024 * 1024)
+// patterns must be shorter than this.
+#define MAX_PATTERN_LENGTH 16
+
+struct capture_stream {
+    int job_id;
+    int pipe_fd;
+    int log_fd;
+    int done;
+    unsigned long counts[CAPTURE_PATTERNS_NUM];
+    unsigned long reported_counts[CAPTURE_PATTERNS_NUM];
+    // the end of the previous read, a pattern may be split between two reads.
+    char tail[MAX_PATTERN_LENGTH];
+    size_t tail_length;
+};
+
+char *capture_patterns[CAPTURE_PATTERNS_NUM] = {
+        "Put task", "Get task", "is reading", "is writing", "is eating", "is using", "is landing", "is starting"
+};
+
+int capture_enabled = 0;
+int epoll_fd = -1;
+pthread_t capture_thread;
+pthread_mutex_t capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t capture_cond = PTHREAD_COND_INITIALIZER;
+struct capture_stream *streams[MAX_JOBS];
+
+void count_patterns(struct capture_stream *stream, char *data, size_t length) {
+    static char buffer[MAX_PATTERN_LENGTH + CAPTURE_BUFFER_SIZE];
+    memcpy(buffer, stream->tail, stream->tail_length);
+    memcpy(buffer + stream->tail_length, data, length);
+    size_t total = stream->tail_length + length;
+    for (int i = 0; i < CAPTURE_PATTERNS_NUM; i++) {
+        size_t pattern_length = strlen(capture_patterns[i]);
+        char *position = buffer;
+        while ((position = memmem(position, total - (position - buffer), capture_patterns[i], pattern_length))) {
+            // a match lying entirely in the tail was counted with the previous read.
+            if ((size_t)(position - buffer) + pattern_length > stream->tail_length)
+                stream->counts[i]++;
+            position += pattern_length;
+        }
+    }
+    stream->tail_length = total < MAX_PATTERN_LENGTH - 1 ? total : MAX_PATTERN_LENGTH - 1;
+    memcpy(stream->tail, buffer + total - stream->tail_length, stream->tail_length);
+}
+
+void drain_stream(struct capture_stream *stream) {
+    static char data[CAPTURE_BUFFER_SIZE];
+    ssize_t length;
+    while ((length = read(stream->pipe_fd, data, CAPTURE_BUFFER_SIZE)) > 0) {
+        if (stream->log_fd >= 0 && write(stream->log_fd, data, length) != length) {
+            close(stream->log_fd);
+            stream->log_fd = -1;
+        }
+        pthread_mutex_lock(&capture_mutex);
+        count_patterns(stream, data, length);
+        pthread_mutex_unlock(&capture_mutex);
+    }
+    if (length == 0 || (errno != EAGAIN && errno != EINTR)) {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, stream->pipe_fd, NULL);
+        close(stream->pipe_fd);
+        if (stream->log_fd >= 0)
+            close(stream->log_fd);
+        pthread_mutex_lock(&capture_mutex);
+        stream->done = 1;
+        pthread_cond_broadcast(&capture_cond);
+        pthread_mutex_unlock(&capture_mutex);
+    }
+}
+
+void print_rates(double elapsed) {
+    pthread_mutex_lock(&capture_mutex);
+    for (int i = 0; i < MAX_JOBS; i++) {
+        struct capture_stream *stream = streams[i];
+        if (stream == NULL || stream->done)
+            continue;
+        char line[512];
+        int line_length = snprintf(line, sizeof line, "[%d]", stream->job_id), empty_length = line_length;
+        for (int j = 0; j < CAPTURE_PATTERNS_NUM; j++) {
+            if (stream->counts[j] == 0)
+                continue;
+            line_length += snprintf(line + line_length, sizeof line - line_length, " %s %.0f/s,",
+                                    capture_patterns[j],
+                                    (double)(stream->counts[j] - stream->reported_counts[j]) / elapsed);
+            stream->reported_counts[j] = stream->counts[j];
+        }
+        if (line_length == empty_length)
+            continue;
+        line[line_length - 1] = '\0';
+        printf("%s\n", line);
+    }
+    fflush(stdout);
+    pthread_mutex_unlock(&capture_mutex);
+}
+
+void *capture_thread_main(void *arg) {
+    struct epoll_event events[MAX_JOBS];
+    uint64_t last_report = launcher_now_ns();
+    while (1) {
+        int timeout = (int)((last_report + 1000000000ull - launcher_now_ns()) / 1000000);
+        int events_num = epoll_wait(epoll_fd, events, MAX_JOBS, timeout > 0 && timeout <= 1000 ? timeout : 0);
+        for (int i = 0; i < events_num; i++)
+            drain_stream(events[i].data.ptr);
+        uint64_t now = launcher_now_ns();
+        if (now >= last_report + 1000000000ull) {
+            print_rates((double)(now - last_report) / 1e9);
+            last_report = now;
+        }
+    }
+    return NULL;
+}
+
+// the thread does not take any signals, they stay with the main loop.
+int capture_init() {
+    if (epoll_fd >= 0)
+        return 0;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        printf("Error while creating epoll instance occurred.\n");
+        return 1;
+    }
+    sigset_t signal_mask, old_signal_mask;
+    sigfillset(&signal_mask);
+    pthread_sigmask(SIG_SETMASK, &signal_mask, &old_signal_mask);
+    int ret = pthread_create(&capture_thread, NULL, capture_thread_main, NULL);
+    pthread_sigmask(SIG_SETMASK, &old_signal_mask, NULL);
+    if (ret != 0) {
+        printf("Error while creating new thread occurred.\n");
+        return 1;
+    }
+    return 0;
+}
+
+// returns the write end of the job's pipe, to become the child's stdout and stderr.
+int capture_open(struct job *job) {
+    int pipe_fds[2];
+    if (capture_init() != 0 || pipe2(pipe_fds, O_CLOEXEC) != 0) {
+        printf("Error while creating pipe occurred.\n");
+        return -1;
+    }
+    fcntl(pipe_fds[0], F_SETPIPE_SZ, CAPTURE_PIPE_SIZE);
+    fcntl(pipe_fds[0], F_SETFL, O_NONBLOCK);
+    struct capture_stream *stream = calloc(1, sizeof(struct capture_stream));
+    if (stream == NULL) {
+        printf("Error while allocating memory occurred.\n");
+        close(pipe_fds[0]);
+        close(pipe_fds[1]);
+        return -1;
+    }
+    stream->job_id = job->id;
+    stream->pipe_fd = pipe_fds[0];
+    stream->log_fd = open(job->log_name, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    pthread_mutex_lock(&capture_mutex);
+    streams[job - jobs] = stream;
+    pthread_mutex_unlock(&capture_mutex);
+    job->capturing = 1;
+    return pipe_fds[1];
+}
+
+// called after the spawn, the child holds its own copy of the write end by then.
+void capture_started(struct job *job, int write_fd, int spawned) {
+    struct capture_stream *stream = streams[job - jobs];
+    close(write_fd);
+    if (!spawned) {
+        close(stream->pipe_fd);
+        if (stream->log_fd >= 0)
+            close(stream->log_fd);
+        stream->done = 1;
+        capture_close(job);
+        return;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = stream;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, stream->pipe_fd, &event);
+}
+
+// waits until the whole output of the job is in its log, then prints the totals.
+void capture_close(struct job *job) {
+    if (!job->capturing)
+        return;
+    pthread_mutex_lock(&capture_mutex);
+    struct capture_stream *stream = streams[job - jobs];
+    while (!stream->done)
+        pthread_cond_wait(&capture_cond, &capture_mutex);
+    streams[job - jobs] = NULL;
+    pthread_mutex_unlock(&capture_mutex);
+    for (int i = 0; i < CAPTURE_PATTERNS_NUM; i++)
+        if (stream->counts[i] > 0)
+            printf("[%d] %s: %lu\n", job->id, capture_patterns[i], stream->counts[i]);
+    free(stream);
+    job->capturing = 0;
+}
@@ -0,0 +1,272 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <unistd.h>
+#include "main.h"
+
+// Compare mode checks batch results (written with json <file>) against a stored baseline. The baseline is a JSON
+// array of records like
+//   {"app": "table", "args": "4 bench 2", "metric": "Throughput", "value": 113000, "tolerance": 0.3, "better": "higher"}
+// The repeats of a case are averaged. A metric where higher is better regresses when it falls more than
+// tolerance (a fraction of the baseline value) below the baseline, one where lower is better when it rises more
+// than tolerance above it. A metric missing from the results counts as a regression too.
+// With update, the baseline values are replaced by the results, tolerances and directions are kept, so a baseline
+// of a machine is recorded by updating a copy of a list of metrics with zero values.
+#define DEFAULT_TOLERANCE 0.2
+#define MAX_METRIC_LENGTH 128
+
+struct json_record {
+    char app[32];
+    char args[MAX_ARGS_LENGTH];
+    char metric[MAX_METRIC_LENGTH];
+    char better[8];
+    double value;
+    double tolerance;
+};
+
+void skip_space(char **position) {
+    while (isspace((unsigned char)**position))
+        (*position)++;
+}
+
+int parse_string(char **position, char *buffer, size_t size) {
+    skip_space(position);
+    if (**position != '"')
+        return 1;
+    (*position)++;
+    size_t length = 0;
+    while (**position != '"') {
+        if (**position == '\0')
+            return 1;
+        if (**position == '\\')
+            (*position)++;
+        if (length + 1 < size)
+            buffer[length++] = **position;
+        (*position)++;
+    }
+    (*position)++;
+    buffer[length] = '\0';
+    return 0;
+}
+
+int parse_record(char **position, struct json_record *record) {
+    memset(record, 0, sizeof *record);
+    record->tolerance = DEFAULT_TOLERANCE;
+    strcpy(record->better, "higher");
+    skip_space(position);
+    if (*(*position)++ != '{')
+        return 1;
+    skip_space(position);
+    while (**position != '}') {
+        char key[32], string_value[MAX_ARGS_LENGTH];
+        if (parse_string(position, key, sizeof key) != 0)
+            return 1;
+        skip_space(position);
+        if (*(*position)++ != ':')
+            return 1;
+        skip_space(position);
+        if (**position == '"') {
+            // strings of unknown keys are read and dropped.
+            char *target = string_value;
+            size_t target_size = sizeof string_value;
+            if (strcmp(key, "app") == 0) {
+                target = record->app;
+                target_size = sizeof record->app;
+            }
+            else if (strcmp(key, "args") == 0) {
+                target = record->args;
+                target_size = sizeof record->args;
+            }
+            else if (strcmp(key, "metric") == 0) {
+                target = record->metric;
+                target_size = sizeof record->metric;
+            }
+            else if (strcmp(key, "better") == 0) {
+                target = record->better;
+                target_size = sizeof record->better;
+            }
+            if (parse_string(position, target, target_size) != 0)
+                return 1;
+        }
+        else {
+            char *end;
+            double value = strtod(*position, &end);
+            if (end == *position)
+                return 1;
+            *position = end;
+            if (strcmp(key, "value") == 0)
+                record->value = value;
+            else if (strcmp(key, "tolerance") == 0)
+                record->tolerance = value;
+        }
+        skip_space(position);
+        if (**position == ',')
+            (*position)++;
+        skip_space(position);
+    }
+    (*position)++;
+    return 0;
+}
+
+// only what batch mode writes is understood: an array of flat objects with string and number values.
+int parse_records(char *text, struct json_record **records, int *records_num) {
+    int capacity = 0;
+    char *position = text;
+    skip_space(&position);
+    if (*position++ != '[')
+        return 1;
+    skip_space(&position);
+    while (*position != ']') {
+        if (*records_num == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            struct json_record *new_records = realloc(*records, capacity * sizeof(struct json_record));
+            if (new_records == NULL)
+                return 1;
+            *records = new_records;
+        }
+        if (parse_record(&position, &(*records)[(*records_num)++]) != 0)
+            return 1;
+        skip_space(&position);
+        if (*position == ',')
+            position++;
+        skip_space(&position);
+    }
+    return 0;
+}
+
+struct json_record *read_json_records(char *file_name, int *records_num) {
+    FILE *file = fopen(file_name, "r");
+    if (file == NULL) {
+        printf("Error while opening %s occurred.\n", file_name);
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+    char *text = malloc(file_size + 1);
+    if (text == NULL || fread(text, 1, file_size, file) != (size_t)file_size) {
+        printf("Error while reading %s occurred.\n", file_name);
+        fclose(file);
+        free(text);
+        return NULL;
+    }
+    fclose(file);
+    text[file_size] = '\0';
+    struct json_record *records = NULL;
+    *records_num = 0;
+    if (parse_records(text, &records, records_num) != 0) {
+        printf("%s is not a list of results.\n", file_name);
+        free(records);
+        records = NULL;
+    }
+    else if (records == NULL) {
+        records = malloc(sizeof(struct json_record));
+    }
+    free(text);
+    return records;
+}
+
+// the mean over the repeats, returns the number of values found.
+int find_result(struct json_record *results, int results_num, struct json_record *baseline, double *mean) {
+    int found = 0;
+    double sum = 0;
+    for (int i = 0; i < results_num; i++) {
+        if (strcmp(results[i].app, baseline->app) == 0 && strcmp(results[i].args, baseline->args) == 0 &&
+            strcmp(results[i].metric, baseline->metric) == 0) {
+            sum += results[i].value;
+            found++;
+        }
+    }
+    *mean = found > 0 ? sum / found : 0;
+    return found;
+}
+
+int write_baseline(char *file_name, struct json_record *records, int records_num) {
+    FILE *file = fopen(file_name, "w");
+    if (file == NULL) {
+        printf("Error while opening %s occurred.\n", file_name);
+        return 1;
+    }
+    fprintf(file, "[");
+    for (int i = 0; i < records_num; i++) {
+        fprintf(file, "%s\n  {\"app\": ", i > 0 ? "," : "");
+        write_json_string(file, records[i].app);
+        fprintf(file, ", \"args\": ");
+        write_json_string(file, records[i].args);
+        fprintf(file, ", \"metric\": ");
+        write_json_string(file, records[i].metric);
+        fprintf(file, ", \"value\": %.6g, \"tolerance\": %g, \"better\": \"%s\"}", records[i].value,
+                records[i].tolerance, records[i].better);
+    }
+    fprintf(file, "\n]\n");
+    fclose(file);
+    return 0;
+}
+
+int run_compare(int argc, char *argv[]) {
+    if (argc < 4 || argc > 5 || (argc == 5 && strcmp(argv[4], "update") != 0)) {
+        printf("Usage: %s compare <results json> <baseline json> [update]\n", argv[0]);
+        return 1;
+    }
+    if (access(argv[3], R_OK) != 0) {
+        printf("There is no baseline %s, record it with update first.\n", argv[3]);
+        return 1;
+    }
+    int results_num, baselines_num;
+    struct json_record *results = read_json_records(argv[2], &results_num);
+    if (results == NULL)
+        return 1;
+    struct json_record *baselines = read_json_records(argv[3], &baselines_num);
+    if (baselines == NULL) {
+        free(results);
+        return 1;
+    }
+    int update = argc == 5, regressions = 0;
+    printf("%-12s %-24s %-32s %12s %12s %8s\n", "app", "args", "metric", "baseline", "result", "change");
+    for (int i = 0; i < baselines_num; i++) {
+        struct json_record *baseline = &baselines[i];
+        double mean;
+        char *status = "ok";
+        int lower_is_better = strcmp(baseline->better, "lower") == 0;
+        if (find_result(results, results_num, baseline, &mean) == 0) {
+            printf("%-12s %-24s %-32s %12.6g %12s %8s  MISSING\n", baseline->app, baseline->args,
+                   baseline->metric, baseline->value, "-", "-");
+            regressions += !update;
+            continue;
+        }
+        double change = baseline->value != 0 ? (mean - baseline->value) / baseline->value : 0;
+        if (update) {
+            status = "recorded";
+        }
+        else if ((lower_is_better && mean > baseline->value * (1 + baseline->tolerance)) ||
+                 (!lower_is_better && mean < baseline->value * (1 - baseline->tolerance))) {
+            status = "REGRESSION";
+            regressions++;
+        }
+        else if ((lower_is_better && change < -baseline->tolerance) ||
+                 (!lower_is_better && change > baseline->tolerance)) {
+            status = "improved";
+        }
+        printf("%-12s %-24s %-32s %12.6g %12.6g %+7.1f%%  %s\n", baseline->app, baseline->args, baseline->metric,
+               baseline->value, mean, change * 100, status);
+        if (update)
+            baseline->value = mean;
+    }
+    int ret = 0;
+    if (update) {
+        ret = write_baseline(argv[3], baselines, baselines_num);
+        if (ret == 0)
+            printf("Baseline %s updated.\n", argv[3]);
+    }
+    else if (regressions > 0) {
+        printf("%d of %d metrics regressed.\n", regressions, baselines_num);
+        ret = 1;
+    }
+    else {
+        printf("All %d metrics within tolerance.\n", baselines_num);
+    }
+    free(results);
+    free(baselines);
+    return ret;
+}
@@ -0,0 +1,313 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <wordexp.h>
+#include <spawn.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "main.h"
+
+// Job control of the interactive launcher. Every started app is a job, background jobs (and all jobs in
+// capture mode) write their output to job_<id>.log. Background jobs run in their own process group, so ^C
+// at the prompt does not reach them.
+// The SIGCHLD handler reaps jobs as they exit and only fills their slots, the main loop reports them.
+// A background job which never overlapped another one becomes the baseline of its app and args, an overlapped
+// job is compared with the baseline: by the throughput from its log when both have it, by CPU time per second
+// of wall time otherwise.
+#define MAX_BASELINES 64
+
+struct job_baseline {
+    int app_id;
+    char args[MAX_ARGS_LENGTH];
+    double throughput;
+    double cpu_rate;
+};
+
+struct job jobs[MAX_JOBS];
+struct job_baseline baselines[MAX_BASELINES];
+int baselines_num = 0;
+int jobs_holding = 0;
+int next_job_id = 1;
+
+extern char **environ;
+
+double job_wall_time(struct job *job) {
+    return (double)(job->end_time - job->start_time) / 1e9;
+}
+
+double job_cpu_time(struct job *job) {
+    return job->usage.ru_utime.tv_sec + job->usage.ru_utime.tv_usec / 1e6 +
+           job->usage.ru_stime.tv_sec + job->usage.ru_stime.tv_usec / 1e6;
+}
+
+void jobs_sigchld_handler(int signum) {
+    int status;
+    struct rusage usage;
+    pid_t pid;
+    while ((pid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+        for (int i = 0; i < MAX_JOBS; i++) {
+            if (jobs[i].state == JOB_RUNNING && jobs[i].pid == pid) {
+                jobs[i].end_time = launcher_now_ns();
+                jobs[i].status = status;
+                jobs[i].usage = usage;
+                jobs[i].state = JOB_DONE;
+                break;
+            }
+        }
+    }
+}
+
+struct job *job_find(int id) {
+    for (int i = 0; i < MAX_JOBS; i++)
+        if (jobs[i].state != JOB_FREE && jobs[i].id == id)
+            return &jobs[i];
+    return NULL;
+}
+
+struct job *job_add(int app_id, char *app_path, char *args, int background) {
+    struct job *job = NULL;
+    for (int i = 0; i < MAX_JOBS && job == NULL; i++)
+        if (jobs[i].state == JOB_FREE)
+            job = &jobs[i];
+    if (job == NULL) {
+        printf("Too many jobs, wait for some of them first.\n");
+        return NULL;
+    }
+    memset(job, 0, sizeof(struct job));
+    job->id = next_job_id++;
+    job->app_id = app_id;
+    job->background = background;
+    snprintf(job->app_path, MAX_PATH_LENGTH, "%s", app_path);
+    snprintf(job->args, MAX_ARGS_LENGTH, "%s", args);
+    if (background || capture_enabled)
+        snprintf(job->log_name, sizeof job->log_name, "job_%d.log", job->id);
+    job->state = JOB_HELD;
+    return job;
+}
+
+// SIGCHLD is blocked while the job is spawned, so the handler always finds the pid in the table.
+int job_start(struct job *job, sigset_t *child_mask) {
+    char command[MAX_PATH_LENGTH + MAX_ARGS_LENGTH + 1];
+    snprintf(command, sizeof command, "%s %s", job->app_path, job->args);
+    wordexp_t parsed_args;
+    if (wordexp(command, &parsed_args, WRDE_NOCMD) != 0) {
+        printf("Incorrect arguments.\n");
+        job->state = JOB_FREE;
+        return 1;
+    }
+    int capture_fd = -1;
+    if (capture_enabled && (capture_fd = capture_open(job)) < 0) {
+        wordfree(&parsed_args);
+        job->state = JOB_FREE;
+        return 1;
+    }
+    posix_spawnattr_t spawn_attr;
+    posix_spawn_file_actions_t file_actions;
+    posix_spawnattr_init(&spawn_attr);
+    posix_spawnattr_setsigmask(&spawn_attr, child_mask);
+    posix_spawn_file_actions_init(&file_actions);
+    if (job->background) {
+        posix_spawnattr_setpgroup(&spawn_attr, 0);
+        posix_spawnattr_setflags(&spawn_attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETPGROUP);
+    }
+    else {
+        posix_spawnattr_setflags(&spawn_attr, POSIX_SPAWN_SETSIGMASK);
+    }
+    if (capture_fd >= 0) {
+        posix_spawn_file_actions_adddup2(&file_actions, capture_fd, STDOUT_FILENO);
+        posix_spawn_file_actions_adddup2(&file_actions, capture_fd, STDERR_FILENO);
+    }
+    else if (job->background) {
+        posix_spawn_file_actions_addopen(&file_actions, STDOUT_FILENO, job->log_name, O_WRONLY | O_CREAT | O_TRUNC,
+                                         0644);
+        posix_spawn_file_actions_adddup2(&file_actions, STDOUT_FILENO, STDERR_FILENO);
+    }
+
+    sigset_t chld_mask, old_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+    fflush(stdout);
+    job->start_time = launcher_now_ns();
+    int ret = posix_spawn(&job->pid, parsed_args.we_wordv[0], &file_actions, &spawn_attr, parsed_args.we_wordv,
+                          environ);
+    if (ret == 0) {
+        for (int i = 0; i < MAX_JOBS; i++) {
+            if (jobs[i].state == JOB_RUNNING) {
+                jobs[i].overlapped = 1;
+                job->overlapped = 1;
+            }
+        }
+        job->state = JOB_RUNNING;
+    }
+    else {
+        job->state = JOB_FREE;
+    }
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    if (capture_fd >= 0)
+        capture_started(job, capture_fd, ret == 0);
+    posix_spawn_file_actions_destroy(&file_actions);
+    posix_spawnattr_destroy(&spawn_attr);
+    wordfree(&parsed_args);
+    if (ret != 0) {
+        printf("Error while creating new process occurred.\n");
+        return 1;
+    }
+    if (job->background)
+        printf("[%d] %d %s %s\n", job->id, (int)job->pid, apps_keys[job->app_id], job->args);
+    return 0;
+}
+
+// the last throughput line of the log, 0 if there is none.
+double job_throughput(struct job *job) {
+    FILE *log = fopen(job->log_name, "r");
+    if (log == NULL)
+        return 0;
+    char line[MAX_ARGS_LENGTH];
+    double throughput = 0, value;
+    while (fgets(line, MAX_ARGS_LENGTH, log) != NULL)
+        if (sscanf(line, "Throughput: %lf", &value) == 1)
+            throughput = value;
+    fclose(log);
+    return throughput;
+}
+
+struct job_baseline *find_baseline(struct job *job, int add) {
+    for (int i = 0; i < baselines_num; i++)
+        if (baselines[i].app_id == job->app_id && strcmp(baselines[i].args, job->args) == 0)
+            return &baselines[i];
+    if (!add)
+        return NULL;
+    struct job_baseline *baseline = &baselines[baselines_num < MAX_BASELINES ? baselines_num++ : MAX_BASELINES - 1];
+    baseline->app_id = job->app_id;
+    strcpy(baseline->args, job->args);
+    return baseline;
+}
+
+void job_report(struct job *job) {
+    int exit_status = WIFEXITED(job->status) ? WEXITSTATUS(job->status) : -WTERMSIG(job->status);
+    double wall_time = job_wall_time(job);
+    double cpu_rate = wall_time > 0 ? job_cpu_time(job) / wall_time : 0;
+    double throughput = job_throughput(job);
+    printf("[%d] Done: %s %s, exit %d, %.2f s, CPU %.0f%%", job->id, apps_keys[job->app_id], job->args,
+           exit_status, wall_time, cpu_rate * 100);
+    if (throughput > 0)
+        printf(", %.1f ops/s", throughput);
+    if (!job->overlapped) {
+        struct job_baseline *baseline = find_baseline(job, 1);
+        baseline->throughput = throughput;
+        baseline->cpu_rate = cpu_rate;
+        printf(", ran alone (baseline)\n");
+        return;
+    }
+    struct job_baseline *baseline = find_baseline(job, 0);
+    if (baseline == NULL)
+        printf(", overlapped, no baseline yet\n");
+    else if (throughput > 0 && baseline->throughput > 0)
+        printf(", %.2fx slowdown (alone %.1f ops/s)\n", baseline->throughput / throughput, baseline->throughput);
+    else if (cpu_rate > 0)
+        printf(", %.2fx CPU slowdown (alone %.0f%%)\n", baseline->cpu_rate / cpu_rate, baseline->cpu_rate * 100);
+    else
+        printf(", overlapped\n");
+}
+
+void jobs_report_done() {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].state == JOB_DONE && jobs[i].background) {
+            capture_close(&jobs[i]);
+            job_report(&jobs[i]);
+            jobs[i].state = JOB_FREE;
+        }
+    }
+}
+
+void jobs_list() {
+    uint64_t now = launcher_now_ns();
+    for (int i = 0; i < MAX_JOBS; i++) {
+        struct job *job = &jobs[i];
+        if (job->state == JOB_FREE || !job->background)
+            continue;
+        printf("[%d] %-8s %6d %7.2f s  %s %s\n", job->id,
+               job->state == JOB_HELD ? "Held" : job->state == JOB_RUNNING ? "Running" : "Done",
+               (int)job->pid, job->state == JOB_HELD ? 0.0 : (double)((job->state == JOB_DONE ? job->end_time : now) -
+               job->start_time) / 1e9, apps_keys[job->app_id], job->args);
+    }
+}
+
+// waits for one job, or for all running jobs when id is 0. ^C (which clears ignore_close) stops waiting.
+void jobs_wait(int id, sigset_t *wait_mask) {
+    sigset_t chld_mask, old_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+    ignore_close = 1;
+    while (ignore_close) {
+        int waiting = 0;
+        for (int i = 0; i < MAX_JOBS; i++)
+            if (jobs[i].state == JOB_RUNNING && (id == 0 || jobs[i].id == id))
+                waiting = 1;
+        if (!waiting)
+            break;
+        sigsuspend(wait_mask);
+    }
+    if (!ignore_close)
+        printf("\nWait interrupted.\n");
+    ignore_close = 0;
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+}
+
+// the apps clean up on SIGINT, the reaper reports them as usual.
+void jobs_kill(int id) {
+    for (int i = 0; i < MAX_JOBS; i++) {
+        struct job *job = &jobs[i];
+        if (job->state == JOB_FREE || !job->background || (id != 0 && job->id != id))
+            continue;
+        if (job->state == JOB_HELD)
+            job->state = JOB_FREE;
+        else if (job->state == JOB_RUNNING)
+            kill(job->pid, SIGINT);
+    }
+}
+
+// held jobs are started back to back, so their measured periods line up.
+void jobs_go(sigset_t *child_mask) {
+    uint64_t start = launcher_now_ns(), last_start = start;
+    int started = 0;
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].state == JOB_HELD && job_start(&jobs[i], child_mask) == 0) {
+            last_start = jobs[i].start_time;
+            started++;
+        }
+    }
+    jobs_holding = 0;
+    printf("Started %d jobs within %.3f ms.\n", started, (double)(last_start - start) / 1e6);
+}
+
+int run_job(int app_id, char *app_path, char *args, int background, sigset_t *child_mask, sigset_t *wait_mask) {
+    struct job *job = job_add(app_id, app_path, args, background);
+    if (job == NULL)
+        return 1;
+    if (background && jobs_holding) {
+        printf("[%d] Held %s %s\n", job->id, apps_keys[app_id], args);
+        return 0;
+    }
+    if (job_start(job, child_mask) != 0)
+        return 1;
+    if (background)
+        return 0;
+
+    // the foreground app gets the ^C, the launcher only notes it while waiting.
+    sigset_t chld_mask, old_mask;
+    sigemptyset(&chld_mask);
+    sigaddset(&chld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &chld_mask, &old_mask);
+    while (job->state == JOB_RUNNING)
+        sigsuspend(wait_mask);
+    sigprocmask(SIG_SETMASK, &old_mask, NULL);
+    capture_close(job);
+    print_run_usage(&job->usage, job_wall_time(job));
+    job->state = JOB_FREE;
+    return 0;
+}
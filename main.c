@@ -4,33 +4,35 @@
 #include <wordexp.h>
 #include <signal.h>
 #include <unistd.h>
+#include <time.h>
 #include <sys/wait.h>
-
-#define COMMAND_MAX_LENGTH 10
-#define MAX_ARGS_LENGTH 1024
-#define MAX_PATH_LENGTH 1024
+#include "main.h"
 
 typedef enum {
-    HELP, QUIT, APP, UNDEFINED
+    HELP, QUIT, APP, JOBS, WAIT, KILL, HOLD, GO, CAPTURE, STATS, UNDEFINED
 } Command;
 
 int read_word(char * buffer, int n);
+int read_line_rest(char *buffer, int n);
 void parse_command(const char * command_str, Command *command, int *chosen_app_id);
 void display_apps();
-int read_app_args(int app_id, char *main_path, wordexp_t *parsed_args);
-char *get_app_path(int app_id, char *main_path);
+int read_app_args(int app_id, char *args, int *background);
 
-void sigchld_handler(int signum) {}
 void sigint_handler(int signum);
 
+int word_ended_line = 1;
+
 int apps_num = 6;
+// tools come after the apps in the tables below, only batch mode runs them.
+int tools_num = 1;
 char *apps_names[] = {
         "Aircraft carrier",
         "Five philosophers",
         "Producers and consumers",
         "Readers and writers",
         "Table in a restaurant",
-        "Printers and processes"
+        "Printers and processes",
+        "Sync microbenchmarks"
 };
 
 char *apps_args[] = {
@@ -39,7 +41,18 @@ char *apps_args[] = {
         "number of producers and number of consumers",
         "number of readers and number of writers",
         "number of pairs",
-        "number of printers and number of processes"
+        "number of printers and number of processes",
+        "optionally seconds per benchmark and a number of threads"
+};
+
+char *apps_keys[] = {
+        "aircraft",
+        "philosophers",
+        "cp",
+        "rw",
+        "table",
+        "printers",
+        "sync"
 };
 
 char *apps_paths[] = {
@@ -48,15 +61,22 @@ char *apps_paths[] = {
         "apps/consumer_producer/cp_main",
         "apps/reader_writer/rw_main",
         "apps/table/table_main",
-        "apps/printers/printers_main"
+        "apps/printers/printers_main",
+        "apps/common/sync_bench"
 };
 int ignore_close = 0;
 
 int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "batch") == 0)
+        return run_batch(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "compare") == 0)
+        return run_compare(argc, argv);
+
     struct sigaction sigchld_action, sigint_action;
     memset(&sigchld_action, 0, sizeof sigchld_action);
     memset(&sigint_action, 0, sizeof sigint_action);
-    sigchld_action.sa_handler = sigchld_handler;
+    sigchld_action.sa_handler = jobs_sigchld_handler;
+    sigchld_action.sa_flags = SA_RESTART;
     sigaction(SIGCHLD, &sigchld_action, NULL);
     sigint_action.sa_handler = sigint_handler;
     sigaction(SIGINT, &sigint_action, NULL);
@@ -64,16 +84,21 @@ int main(int argc, char *argv[]) {
 
     char command_buffer[COMMAND_MAX_LENGTH];
     Command command = UNDEFINED;
-    int chosen_app_id;
-    wordexp_t parsed_args;
-    sigset_t mask, wait_mask, old_mask;
+    int chosen_app_id, background, job_id;
+    char args[MAX_ARGS_LENGTH];
+    sigset_t mask, wait_mask, jobs_wait_mask, old_mask;
+    // the reaper runs at the prompt, so finished background jobs are noticed at once.
     sigfillset(&mask);
     sigdelset(&mask, SIGTSTP);
     sigdelset(&mask, SIGINT);
+    sigdelset(&mask, SIGCHLD);
     sigfillset(&wait_mask);
     sigdelset(&wait_mask, SIGCHLD);
+    jobs_wait_mask = wait_mask;
+    sigdelset(&jobs_wait_mask, SIGINT);
     sigprocmask(SIG_SETMASK, &mask, &old_mask);
     do {
+        jobs_report_done();
         printf("$ ");
         if (read_word(command_buffer, COMMAND_MAX_LENGTH) == 0)
             continue;
@@ -82,6 +107,40 @@ int main(int argc, char *argv[]) {
             case HELP:
                 printf("Choose one of apps below. To exit, enter quit or q.\n");
                 display_apps();
+                printf("End the args with & to run the app in the background (output goes to job_<id>.log).\n"
+                       "Background jobs: jobs, wait [id], kill [id]. After hold, background jobs wait for go,\n"
+                       "which starts them together.\n"
+                       "capture switches capture mode, where output of jobs goes to their logs through the launcher,\n"
+                       "which prints rates of known events every second.\n"
+                       "stats [seconds] shows the live counters of running background jobs every second\n"
+                       "(for 5 seconds by default, ^C stops it).\n");
+                break;
+            case CAPTURE:
+                capture_enabled = !capture_enabled;
+                printf("Capture mode %s.\n", capture_enabled ? "on" : "off");
+                break;
+            case JOBS:
+                jobs_list();
+                break;
+            case STATS:
+                read_line_rest(args, MAX_ARGS_LENGTH);
+                stats_show(atoi(args) > 0 ? atoi(args) : 5);
+                break;
+            case WAIT:
+            case KILL:
+                read_line_rest(args, MAX_ARGS_LENGTH);
+                job_id = atoi(args);
+                if (command == WAIT)
+                    jobs_wait(job_id, &jobs_wait_mask);
+                else
+                    jobs_kill(job_id);
+                break;
+            case HOLD:
+                jobs_holding = 1;
+                printf("Background jobs are held until go.\n");
+                break;
+            case GO:
+                jobs_go(&old_mask);
                 break;
             case QUIT:
                 break;
@@ -90,31 +149,22 @@ int main(int argc, char *argv[]) {
                 break;
             case APP:
                 printf("Chosen %d\n", chosen_app_id + 1);
-                char *app_path = get_app_path(chosen_app_id, argv[0]);
-                if (read_app_args(chosen_app_id, app_path, &parsed_args) != 0) {
+                if (read_app_args(chosen_app_id, args, &background) != 0) {
                     printf("Incorrect arguments.\n");
                     break;
                 }
                 printf ("Args ok.\n");
-                fflush(stdout);
-                ignore_close = 1;
-                pid_t pid = fork();
-                if (pid < 0) {
-                    printf("Error while creating new process occurred.\n");
-                }
-                else if (pid == 0) {
-                    sigprocmask(SIG_SETMASK, &old_mask, NULL);
-                    execv(app_path, parsed_args.we_wordv);
-                }
-                else {
-                    sigsuspend(&wait_mask);
-                    waitpid(pid, NULL, 0);
-                }
-                wordfree(&parsed_args);
+                char *app_path = get_app_path(chosen_app_id, argv[0]);
+                if (!background)
+                    ignore_close = 1;
+                run_job(chosen_app_id, app_path, args, background, &old_mask, &wait_mask);
                 free(app_path);
                 break;
         }
     } while (command != QUIT);
+    jobs_kill(0);
+    jobs_wait(0, &jobs_wait_mask);
+    jobs_report_done();
     printf("\nApplication closed.\n");
     return 0;
 }
@@ -125,26 +175,46 @@ void display_apps() {
     }
 }
 
-int read_app_args(int app_id, char *app_path, wordexp_t *parsed_args) {
-    char args[MAX_ARGS_LENGTH];
-    strcpy(args, app_path);
-    if (strlen(apps_args[app_id]) > 0) {
-        char c;
-        int i;
+// args given on the command line after the app number are taken as they are, otherwise they are asked for.
+// A trailing & asks for a background job.
+int read_app_args(int app_id, char *args, int *background) {
+    args[0] = '\0';
+    if (!word_ended_line) {
+        read_line_rest(args, MAX_ARGS_LENGTH);
+    }
+    else if (strlen(apps_args[app_id]) > 0) {
         printf("Enter following args - %s: ", apps_args[app_id]);
-        i = (int)strlen(args);
-        args[i] = ' ';
-        i++;
-        c = (char)getchar();
-        while (c != '\n' && i < MAX_ARGS_LENGTH - 1) {
-            args[i] = c;
-            i++;
+        word_ended_line = 0;
+        read_line_rest(args, MAX_ARGS_LENGTH);
+    }
+    size_t length = strlen(args);
+    while (length > 0 && (args[length - 1] == ' ' || args[length - 1] == '\t'))
+        length--;
+    *background = length > 0 && args[length - 1] == '&';
+    if (*background)
+        while (length > 0 && (args[length - 1] == '&' || args[length - 1] == ' ' || args[length - 1] == '\t'))
+            length--;
+    args[length] = '\0';
+    wordexp_t parsed_args;
+    if (wordexp(args, &parsed_args, WRDE_NOCMD) != 0)
+        return 1;
+    wordfree(&parsed_args);
+    return 0;
+}
+
+int read_line_rest(char *buffer, int n) {
+    int i = 0;
+    if (!word_ended_line) {
+        char c = (char)getchar();
+        while (c != '\n' && i < n - 1) {
+            buffer[i++] = c;
             c = (char)getchar();
         }
         while (c != '\n') c = (char)getchar();
-        args[i] = '\0';
     }
-    return wordexp(args, parsed_args, 0) != 0;
+    buffer[i] = '\0';
+    word_ended_line = 1;
+    return i;
 }
 
 int read_word(char * buffer, int n) {
@@ -164,6 +234,7 @@ int read_word(char * buffer, int n) {
         while (c != '\n' && c != ' ' && c != '\t')
             c = (char)getchar();
     *buffer = '\0';
+    word_ended_line = c == '\n';
     return i;
 }
 
@@ -173,6 +244,20 @@ void parse_command(const char * command_str, Command *command, int *chosen_app_i
         *command = HELP;
     else if (strcmp(command_str, "quit") == 0 || strcmp(command_str, "q") == 0)
         *command = QUIT;
+    else if (strcmp(command_str, "jobs") == 0)
+        *command = JOBS;
+    else if (strcmp(command_str, "wait") == 0)
+        *command = WAIT;
+    else if (strcmp(command_str, "kill") == 0)
+        *command = KILL;
+    else if (strcmp(command_str, "hold") == 0)
+        *command = HOLD;
+    else if (strcmp(command_str, "go") == 0)
+        *command = GO;
+    else if (strcmp(command_str, "capture") == 0)
+        *command = CAPTURE;
+    else if (strcmp(command_str, "stats") == 0)
+        *command = STATS;
     else if (app_id > 0 && app_id <= apps_num) {
         *command = APP;
         *chosen_app_id = app_id - 1;
@@ -197,6 +282,23 @@ char *get_app_path(int app_id, char *main_path) {
     return path;
 }
 
+uint64_t launcher_now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+// children of the app are included when the app waited for them before exiting.
+void print_run_usage(struct rusage *usage, double wall_time) {
+    double user_time = usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6;
+    double sys_time = usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6;
+    printf("Run time: wall %.2f s, user %.2f s, sys %.2f s, CPU %.0f%%\n", wall_time, user_time, sys_time,
+           wall_time > 0 ? (user_time + sys_time) / wall_time * 100 : 0.0);
+    printf("Memory: max RSS %ld KB, minor faults %ld, major faults %ld\n", usage->ru_maxrss, usage->ru_minflt,
+           usage->ru_majflt);
+    printf("Context switches: voluntary %ld, involuntary %ld\n", usage->ru_nvcsw, usage->ru_nivcsw);
+}
+
 void sigint_handler(int signum) {
     if (ignore_close == 1)
         ignore_close = 0;
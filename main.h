@@ -0,0 +1,68 @@
+#ifndef PROJECT_MAIN_H
+#define PROJECT_MAIN_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#define COMMAND_MAX_LENGTH 10
+#define MAX_ARGS_LENGTH 1024
+#define MAX_PATH_LENGTH 1024
+#define MAX_JOBS 64
+#define CAPTURE_PATTERNS_NUM 8
+
+enum job_state {
+    JOB_FREE, JOB_HELD, JOB_RUNNING, JOB_DONE
+};
+
+struct job {
+    int id;
+    volatile sig_atomic_t state;
+    pid_t pid;
+    int app_id;
+    int background;
+    int overlapped;
+    int capturing;
+    char app_path[MAX_PATH_LENGTH];
+    char args[MAX_ARGS_LENGTH];
+    char log_name[32];
+    uint64_t start_time;
+    uint64_t end_time;
+    int status;
+    struct rusage usage;
+};
+
+extern int apps_num;
+extern int tools_num;
+extern char *apps_names[];
+extern char *apps_keys[];
+extern char *apps_paths[];
+extern int ignore_close;
+extern int jobs_holding;
+extern int capture_enabled;
+extern struct job jobs[];
+
+char *get_app_path(int app_id, char *main_path);
+uint64_t launcher_now_ns();
+void print_run_usage(struct rusage *usage, double wall_time);
+int run_batch(int argc, char *argv[]);
+void write_json_string(FILE *file, char *string);
+int run_compare(int argc, char *argv[]);
+
+void jobs_sigchld_handler(int signum);
+int run_job(int app_id, char *app_path, char *args, int background, sigset_t *child_mask, sigset_t *wait_mask);
+void jobs_report_done();
+void jobs_list();
+void jobs_wait(int id, sigset_t *wait_mask);
+void jobs_kill(int id);
+void jobs_go(sigset_t *child_mask);
+
+int capture_open(struct job *job);
+void capture_started(struct job *job, int write_fd, int spawned);
+void capture_close(struct job *job);
+
+void stats_show(int seconds);
+
+#endif //PROJECT_MAIN_H
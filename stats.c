@@ -0,0 +1,40 @@
+#include <stdio.h>
+#include <time.h>
+#include "apps/common/metrics.h"
+#include "main.h"
+
+// stats command: the live counters of the running background jobs, sampled from their metrics segments once
+// a second. The apps are never stopped or asked for anything, only their shared memory is read.
+void stats_show(int seconds) {
+    struct metrics_view views[MAX_JOBS];
+    int job_ids[MAX_JOBS];
+    int views_num = 0;
+    for (int i = 0; i < MAX_JOBS; i++) {
+        if (jobs[i].state != JOB_RUNNING || metrics_view_open(&views[views_num], jobs[i].pid) != 0)
+            continue;
+        job_ids[views_num++] = jobs[i].id;
+    }
+    if (views_num == 0) {
+        printf("No running jobs with metrics.\n");
+        return;
+    }
+    ignore_close = 1;
+    for (int second = 0; second < seconds && ignore_close; second++) {
+        struct timespec remaining = {1, 0};
+        while (nanosleep(&remaining, &remaining) != 0 && ignore_close)
+            ;
+        if (!ignore_close)
+            break;
+        for (int i = 0; i < views_num; i++) {
+            char prefix[16];
+            snprintf(prefix, sizeof prefix, "[%d] ", job_ids[i]);
+            metrics_view_print(&views[i], prefix);
+        }
+        fflush(stdout);
+    }
+    if (!ignore_close)
+        printf("\nStats interrupted.\n");
+    ignore_close = 0;
+    for (int i = 0; i < views_num; i++)
+        metrics_view_close(&views[i]);
+}